@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -43,9 +44,75 @@
 #include "expression.h"
 #include "linearize.h"
 
+///
+// give back a blob no longer used
+//
+// The biggest one is kept, cleared, for the next blob: some allocators
+// are emptied at each function and the blobs can be quite big.
+static void free_blob(struct allocator_struct *desc, struct allocation_blob *blob)
+{
+	struct allocation_blob *spare = desc->spare;
+
+	desc->blob_bytes -= blob->size;
+	if (!spare || spare->size < blob->size) {
+		memset(blob->data, 0, blob->offset);
+		desc->spare = blob;
+		blob = spare;
+	}
+	if (blob)
+		blob_free(blob, blob->size);
+}
+
+///
+// get a new blob, big enough for an allocation of @size bytes
+//
+// The blobs grow geometrically, from CHUNK to MAX_CHUNK, each one being
+// about as big as all the others together, so that the allocators with
+// a lot of data use few big blobs and the ones with little data (or
+// often released) don't waste memory. An allocation too big for this
+// size is given its own blob. For the allocators allowing it,
+// the biggest blobs are backed by huge pages if -fhuge-pages is used.
+static struct allocation_blob *new_blob(struct allocator_struct *desc, unsigned int size)
+{
+	unsigned long alignment = desc->alignment;
+	unsigned long offset = offsetof(struct allocation_blob, data);
+	unsigned long chunking = desc->chunking;
+	struct allocation_blob *blob;
+
+	offset = (offset + alignment - 1) & ~(alignment-1);
+	while (chunking < desc->blob_bytes && chunking < MAX_CHUNK)
+		chunking *= 2;
+	if (offset + size > chunking) {
+		chunking = (offset + size + CHUNK - 1) & ~(CHUNK - 1);
+		desc->big_allocs++;
+	}
+
+	blob = desc->spare;
+	if (blob && blob->size >= chunking) {
+		desc->spare = NULL;
+	} else {
+		bool huge = desc->huge && fhuge_pages && chunking >= MAX_CHUNK;
+
+		blob = huge ? blob_alloc_huge(chunking) : blob_alloc(chunking);
+		if (!blob)
+			die("out of memory");
+		blob->size = chunking;
+		desc->total_bytes += chunking;
+		desc->nr_blobs++;
+		desc->huge_blobs += huge;
+	}
+	blob->next = desc->blobs;
+	desc->blobs = blob;
+	desc->blob_bytes += blob->size;
+	blob->left = blob->size - offset;
+	blob->offset = offset - offsetof(struct allocation_blob, data);
+	return blob;
+}
+
 void protect_allocations(struct allocator_struct *desc)
 {
 	desc->blobs = NULL;
+	desc->blob_bytes = 0;
 }
 
 void drop_all_allocations(struct allocator_struct *desc)
@@ -56,12 +123,56 @@ void drop_all_allocations(struct allocator_struct *desc)
 	desc->allocations = 0;
 	desc->total_bytes = 0;
 	desc->useful_bytes = 0;
+	desc->nr_blobs = 0;
+	desc->huge_blobs = 0;
+	desc->big_allocs = 0;
 	desc->freelist = NULL;
 	while (blob) {
 		struct allocation_blob *next = blob->next;
-		blob_free(blob, desc->chunking);
+		free_blob(desc, blob);
+		blob = next;
+	}
+}
+
+///
+// remember the current position of an allocator
+//
+// The freelist is put aside until the release: its entries may be
+// reused and then released, their link is then lost.
+void mark_allocations(struct allocator_struct *desc, struct allocation_mark *mark)
+{
+	struct allocation_blob *blob = desc->blobs;
+
+	mark->blob = blob;
+	mark->left = blob ? blob->left : 0;
+	mark->offset = blob ? blob->offset : 0;
+	mark->freelist = desc->freelist;
+	desc->freelist = NULL;
+}
+
+///
+// free everything allocated since the mark, in one go
+//
+// The entries allocated before the mark and freed since are lost.
+// The statistics are not changed, they count all the allocations.
+// The part of the last blob given back is cleared since the users of
+// the allocators expect a zeroed memory, like the one of new blobs.
+void release_allocations(struct allocator_struct *desc, struct allocation_mark *mark)
+{
+	struct allocation_blob *blob = desc->blobs;
+
+	while (blob != mark->blob) {
+		struct allocation_blob *next = blob->next;
+		free_blob(desc, blob);
 		blob = next;
 	}
+	desc->blobs = blob;
+	if (blob) {
+		memset(blob->data + mark->offset, 0, blob->offset - mark->offset);
+		blob->left = mark->left;
+		blob->offset = mark->offset;
+	}
+	desc->freelist = mark->freelist;
 }
 
 void free_one_entry(struct allocator_struct *desc, void *entry)
@@ -98,22 +209,8 @@ void *allocate(struct allocator_struct *desc, unsigned int size)
 	desc->allocations++;
 	desc->useful_bytes += size;
 	size = (size + alignment - 1) & ~(alignment-1);
-	if (!blob || blob->left < size) {
-		unsigned int offset, chunking = desc->chunking;
-		struct allocation_blob *newblob = blob_alloc(chunking);
-		if (!newblob)
-			die("out of memory");
-		if (size > chunking)
-			die("alloc too big");
-		desc->total_bytes += chunking;
-		newblob->next = blob;
-		blob = newblob;
-		desc->blobs = newblob;
-		offset = offsetof(struct allocation_blob, data);
-		offset = (offset + alignment - 1) & ~(alignment-1);
-		blob->left = chunking - offset;
-		blob->offset = offset - offsetof(struct allocation_blob, data);
-	}
+	if (!blob || blob->left < size)
+		blob = new_blob(desc, size);
 	retval = blob->data + blob->offset;
 	blob->offset += size;
 	blob->left -= size;
@@ -133,12 +230,15 @@ void get_allocator_stats(struct allocator_struct *x, struct allocator_stats *s)
 {
 	s->name = x->name;
 	s->allocations = x->allocations;
+	s->nr_blobs = x->nr_blobs;
+	s->huge_blobs = x->huge_blobs;
+	s->big_allocs = x->big_allocs;
 	s->useful_bytes = x->useful_bytes;
 	s->total_bytes = x->total_bytes;
 }
 
 ALLOCATOR(ident, "identifiers");
-ALLOCATOR(token, "tokens");
+HUGE_ALLOCATOR(token, "tokens");
 ALLOCATOR(context, "contexts");
 ALLOCATOR(symbol, "symbols");
 ALLOCATOR(asm_operand, "asmops");
@@ -149,7 +249,7 @@ ALLOCATOR(scope, "scopes");
 __DO_ALLOCATOR(void, 0, 1, "bytes", bytes);
 ALLOCATOR(basic_block, "basic_block");
 ALLOCATOR(entrypoint, "entrypoint");
-ALLOCATOR(instruction, "instruction");
+HUGE_ALLOCATOR(instruction, "instruction");
 ALLOCATOR(multijmp, "multijmp");
 ALLOCATOR(pseudo, "pseudo");
 
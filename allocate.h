@@ -6,28 +6,43 @@
 struct allocation_blob {
 	struct allocation_blob *next;
 	unsigned int left, offset;
+	unsigned long size;
 	unsigned char data[];
 };
 
 struct allocator_struct {
 	const char *name;
 	struct allocation_blob *blobs;
+	struct allocation_blob *spare;	// a released blob, kept for reuse
 	unsigned int alignment;
-	unsigned int chunking;
+	unsigned int chunking;		// the size of the first blob
+	unsigned long blob_bytes;	// the size of all the blobs in use
+	unsigned int huge:1;		// may use huge pages (-fhuge-pages)
 	void *freelist;
 	/* statistics */
 	unsigned int allocations;
+	unsigned int nr_blobs, huge_blobs, big_allocs;
 	unsigned long total_bytes, useful_bytes;
 };
 
+// a position in an allocator, to release everything allocated after it
+struct allocation_mark {
+	struct allocation_blob *blob;
+	unsigned int left, offset;
+	void *freelist;
+};
+
 struct allocator_stats {
 	const char *name;
 	unsigned int allocations;
+	unsigned int nr_blobs, huge_blobs, big_allocs;
 	unsigned long total_bytes, useful_bytes;
 };
 
 extern void protect_allocations(struct allocator_struct *desc);
 extern void drop_all_allocations(struct allocator_struct *desc);
+extern void mark_allocations(struct allocator_struct *desc, struct allocation_mark *mark);
+extern void release_allocations(struct allocator_struct *desc, struct allocation_mark *mark);
 extern void *allocate(struct allocator_struct *desc, unsigned int size);
 extern void free_one_entry(struct allocator_struct *desc, void *entry);
 extern void show_allocations(struct allocator_struct *);
@@ -40,14 +55,20 @@ extern void show_allocation_stats(void);
 	extern void show_##x##_alloc(void);	\
 	extern void get_##x##_stats(struct allocator_stats *);		\
 	extern void clear_##x##_alloc(void);	\
-	extern void protect_##x##_alloc(void);
+	extern void protect_##x##_alloc(void);	\
+	extern void mark_##x##_alloc(struct allocation_mark *);		\
+	extern void release_##x##_alloc(struct allocation_mark *);
 #define DECLARE_ALLOCATOR(x) __DECLARE_ALLOCATOR(struct x, x)
 
 #define __DO_ALLOCATOR(type, objsize, objalign, objname, x)	\
+	__DO_ALLOCATOR_HUGE(type, objsize, objalign, objname, x, 0)
+
+#define __DO_ALLOCATOR_HUGE(type, objsize, objalign, objname, x, objhuge) \
 	static struct allocator_struct x##_allocator = {	\
 		.name = objname,				\
 		.alignment = objalign,				\
-		.chunking = CHUNK };				\
+		.chunking = CHUNK,				\
+		.huge = objhuge };				\
 	type *__alloc_##x(int extra)				\
 	{							\
 		return allocate(&x##_allocator, objsize+extra);	\
@@ -71,6 +92,14 @@ extern void show_allocation_stats(void);
 	void protect_##x##_alloc(void)				\
 	{							\
 		protect_allocations(&x##_allocator);		\
+	}							\
+	void mark_##x##_alloc(struct allocation_mark *mark)	\
+	{							\
+		mark_allocations(&x##_allocator, mark);		\
+	}							\
+	void release_##x##_alloc(struct allocation_mark *mark)	\
+	{							\
+		release_allocations(&x##_allocator, mark);	\
 	}
 
 #define __ALLOCATOR(t, n, x) 					\
@@ -78,6 +107,10 @@ extern void show_allocation_stats(void);
 
 #define ALLOCATOR(x, n) __ALLOCATOR(struct x, n, x)
 
+// for the allocators with a lot of data, which may use huge pages
+#define HUGE_ALLOCATOR(x, n)					\
+	__DO_ALLOCATOR_HUGE(struct x, sizeof(struct x), __alignof__(struct x), n, x, 1)
+
 DECLARE_ALLOCATOR(ident);
 DECLARE_ALLOCATOR(token);
 DECLARE_ALLOCATOR(context);
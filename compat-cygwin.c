@@ -44,12 +44,37 @@ void *blob_alloc(unsigned long size)
 	return ptr;	
 }	
 	
+void *blob_alloc_huge(unsigned long size)
+{
+	return blob_alloc(size);
+}
+
 void blob_free(void *addr, unsigned long size)	
 {	
 	size = (size + 4095) & ~4095;	
 	munmap(addr, size);	
 }	
 	
+/*
+ * Map the whole content of a regular file, read-only.
+ * Returns NULL if the file can't be mapped; the caller
+ * must then fall back to read().
+ */
+void *file_map(int fd, unsigned long size)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+		ptr = NULL;
+	return ptr;
+}
+
+void file_unmap(void *addr, unsigned long size)
+{
+	munmap(addr, size);
+}
+
 long double string_to_ld(const char *nptr, char **endptr) 	
 {	
 	return strtod(nptr, endptr);	
@@ -28,6 +28,7 @@
 #include <winbase.h>	
 #include <stdlib.h>	
 #include <string.h>	
+#include <unistd.h>
 	
 #include "lib.h"
 #include "allocate.h"
@@ -42,11 +43,40 @@ void *blob_alloc(unsigned long size)
 	return ptr;	
 }	
 	
+void *blob_alloc_huge(unsigned long size)
+{
+	return blob_alloc(size);
+}
+
 void blob_free(void *addr, unsigned long size)	
 {	
 	free(addr);	
 }	
 	
+/*
+ * No mmap() here: return a malloc()ed copy of the file.
+ */
+void *file_map(int fd, unsigned long size)
+{
+	unsigned long done = 0;
+	char *ptr = malloc(size);
+
+	while (ptr && done < size) {
+		int n = read(fd, ptr + done, size - done);
+		if (n <= 0) {
+			free(ptr);
+			return NULL;
+		}
+		done += n;
+	}
+	return ptr;
+}
+
+void file_unmap(void *addr, unsigned long size)
+{
+	free(addr);
+}
+
 long double string_to_ld(const char *nptr, char **endptr) 	
 {	
 	return strtod(nptr, endptr);	
@@ -7,8 +7,12 @@
  *
  *  - zeroed anonymous mmap
  *	Missing in MinGW
+ *  - read-only mapping of a whole file
+ *	Missing in MinGW
  *  - "string to long double" (C99 strtold())
  *	Missing in Solaris and MinGW
+ *  - transparent huge pages for the blobs
+ *	Only where madvise(MADV_HUGEPAGE) exists
  */
 
 /*
@@ -19,8 +23,17 @@
  */
 #define CHUNK 32768
 
+/*
+ * The blobs grow geometrically up to this size, which is also the
+ * size of the huge pages on most machines.
+ */
+#define MAX_CHUNK (2UL << 20)
+
 void *blob_alloc(unsigned long size);
+void *blob_alloc_huge(unsigned long size);
 void blob_free(void *addr, unsigned long size);
+void *file_map(int fd, unsigned long size);
+void file_unmap(void *addr, unsigned long size);
 long double string_to_ld(const char *nptr, char **endptr);
 
 #endif
@@ -10,14 +10,14 @@
 #endif
 
 /*
- * Our blob allocator enforces the strict CHUNK size
- * requirement, as a portability check.
+ * Our blob allocator enforces the CHUNK size requirement,
+ * as a portability check.
  */
 void *blob_alloc(unsigned long size)
 {
 	void *ptr;
 
-	if (size & ~CHUNK)
+	if (!size || (size % CHUNK))
 		die("internal error: bad allocation size (%lu bytes)", size);
 	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (ptr == MAP_FAILED)
@@ -25,9 +25,35 @@ void *blob_alloc(unsigned long size)
 	return ptr;
 }
 
+/*
+ * Same, but for big blobs which should rather use transparent huge
+ * pages: the mapping is aligned on MAX_CHUNK so that the kernel can
+ * back it with huge pages. Only a hint, the blob is usable anyway.
+ */
+void *blob_alloc_huge(unsigned long size)
+{
+#ifdef MADV_HUGEPAGE
+	char *ptr, *start;
+
+	if (!size || (size % MAX_CHUNK))
+		return blob_alloc(size);
+	ptr = mmap(NULL, size + MAX_CHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	start = (char *) (((unsigned long) ptr + MAX_CHUNK - 1) & ~(MAX_CHUNK - 1));
+	if (start != ptr)
+		munmap(ptr, start - ptr);
+	munmap(start + size, ptr + MAX_CHUNK - start);
+	madvise(start, size, MADV_HUGEPAGE);
+	return start;
+#else
+	return blob_alloc(size);
+#endif
+}
+
 void blob_free(void *addr, unsigned long size)
 {
-	if (!size || (size & ~CHUNK) || ((unsigned long) addr & 512))
+	if (!size || (size % CHUNK) || ((unsigned long) addr & 512))
 		die("internal error: bad blob free (%lu bytes at %p)", size, addr);
 #ifndef DEBUG
 	munmap(addr, size);
@@ -35,3 +61,23 @@ void blob_free(void *addr, unsigned long size)
 	mprotect(addr, size, PROT_NONE);
 #endif
 }
+
+/*
+ * Map the whole content of a regular file, read-only.
+ * Returns NULL if the file can't be mapped; the caller
+ * must then fall back to read().
+ */
+void *file_map(int fd, unsigned long size)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+		ptr = NULL;
+	return ptr;
+}
+
+void file_unmap(void *addr, unsigned long size)
+{
+	munmap(addr, size);
+}
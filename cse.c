@@ -3,6 +3,13 @@
  * see if we can simplify it and apply CSE on it.
  *
  * Copyright (C) 2004 Linus Torvalds
+ *
+ * This is done as a dominator-based value numbering: the dominator
+ * tree is walked in preorder, keeping a table of the instructions
+ * seen in the blocks dominating the current one. An instruction
+ * equal to one already in the table is thus dominated by it and
+ * can be replaced by it. When leaving a block, its instructions
+ * are removed from the table.
  */
 
 #include <string.h>
@@ -19,9 +26,6 @@
 #include "flow.h"
 #include "cse.h"
 
-#define INSN_HASH_SIZE 256
-static struct instruction_list *insn_hash_table[INSN_HASH_SIZE];
-
 static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 {
 	const struct instruction *def1 = phi1->def;
@@ -35,7 +39,10 @@ static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 }
 
 
-void cse_collect(struct instruction *insn)
+///
+// hash an instruction for the CSE
+// @return: the hash or 0 if the instruction can't be CSEed.
+static unsigned long insn_hash(struct instruction *insn)
 {
 	unsigned long hash;
 
@@ -97,7 +104,7 @@ void cse_collect(struct instruction *insn)
 	case OP_PTRCAST:
 	case OP_UTPTR: case OP_PTRTU:
 		if (!insn->orig_type || insn->orig_type->bit_size < 0)
-			return;
+			return 0;
 		hash += hashval(insn->src);
 
 		// Note: see corresponding line in insn_compare()
@@ -123,11 +130,11 @@ void cse_collect(struct instruction *insn)
 		 * Nothing to do, don't even bother hashing them,
 		 * we're not going to try to CSE them
 		 */
-		return;
+		return 0;
 	}
-	hash += hash >> 16;
-	hash &= INSN_HASH_SIZE-1;
-	add_instruction(insn_hash_table + hash, insn);
+	hash *= 0x9e3779b97f4a7c15ULL;
+	hash ^= hash >> 32;
+	return hash | 1;
 }
 
 /* Compare two (sorted) phi-lists */
@@ -265,11 +272,6 @@ static int insn_compare(const void *_i1, const void *_i2)
 	return 0;
 }
 
-static void sort_instruction_list(struct instruction_list **list)
-{
-	sort_list((struct ptr_list **)list , insn_compare);
-}
-
 static struct instruction * cse_one_instruction(struct instruction *insn, struct instruction *def)
 {
 	convert_instruction_target(insn, def->target);
@@ -279,94 +281,197 @@ static struct instruction * cse_one_instruction(struct instruction *insn, struct
 	return def;
 }
 
-static struct basic_block *trivial_common_parent(struct basic_block *bb1, struct basic_block *bb2)
-{
-	struct basic_block *parent;
+////////////////////////////////////////////////////////////////////////
+// The table of the available instructions.
+//
+// It uses open addressing with linear probing. Since the entries are
+// removed in the reverse order of their insertion, removing an entry
+// only needs to clear its slot: the table is then exactly as it was
+// before the insertion. The slots used are kept on a stack for this.
 
-	if (bb_list_size(bb1->parents) != 1)
-		return NULL;
-	parent = first_basic_block(bb1->parents);
-	if (bb_list_size(bb2->parents) != 1)
-		return NULL;
-	if (first_basic_block(bb2->parents) != parent)
-		return NULL;
-	return parent;
+struct cse_entry {
+	unsigned long hash;
+	struct instruction *insn;
+};
+
+static struct cse_entry *cse_table;
+static unsigned long cse_mask;
+static unsigned long *cse_stack;
+static unsigned long cse_top;
+
+// Instructions of blocks with a single parent, kept for the whole walk
+// to find identical ones in sibling blocks (see cse_siblings()).
+static struct cse_entry *sibling_table;
+static unsigned long *sibling_slots;
+static unsigned long sibling_nr;
+
+static void cse_table_init(unsigned long nr)
+{
+	unsigned long size = 64;
+
+	// keep the load factor under 1/2
+	while (size < 2 * nr)
+		size *= 2;
+	if (!cse_table || size > cse_mask + 1) {
+		free(cse_table);
+		free(cse_stack);
+		free(sibling_table);
+		free(sibling_slots);
+		cse_table = calloc(size, sizeof(*cse_table));
+		cse_stack = calloc(size, sizeof(*cse_stack));
+		sibling_table = calloc(size, sizeof(*sibling_table));
+		sibling_slots = calloc(size, sizeof(*sibling_slots));
+		if (!cse_table || !cse_stack || !sibling_table || !sibling_slots)
+			die("out of memory");
+		cse_mask = size - 1;
+	}
+	cse_top = 0;
 }
 
-static inline void remove_instruction(struct instruction_list **list, struct instruction *insn, int count)
+static void cse_table_clear(void)
 {
-	delete_ptr_list_entry((struct ptr_list **)list, insn, count);
+	// the main table is empty once the walk is done
+	while (sibling_nr) {
+		struct cse_entry *entry = &sibling_table[sibling_slots[--sibling_nr]];
+		entry->hash = 0;
+		entry->insn = NULL;
+	}
 }
 
-static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction *i1, struct instruction *i2)
+///
+// look for an instruction equal to @insn in the table
+// @slot: where to add @insn if none is found
+// @return: the instruction found or NULL.
+static struct instruction *cse_lookup(struct instruction *insn, unsigned long hash, unsigned long *slot)
 {
-	struct basic_block *b1, *b2, *common;
-
-	/*
-	 * OK, i1 and i2 are the same instruction, modulo "target".
-	 * We should now see if we can combine them.
-	 */
-	b1 = i1->bb;
-	b2 = i2->bb;
-
-	/*
-	 * Currently we only handle the uninteresting degenerate case where
-	 * the CSE is inside one basic-block.
-	 */
-	if (b1 == b2) {
-		struct instruction *insn;
-		FOR_EACH_PTR(b1->insns, insn) {
-			if (insn == i1)
-				return cse_one_instruction(i2, i1);
-			if (insn == i2)
-				return cse_one_instruction(i1, i2);
-		} END_FOR_EACH_PTR(insn);
-		warning(b1->pos, "Whaa? unable to find CSE instructions");
-		return i1;
+	unsigned long i;
+
+	for (i = hash & cse_mask; cse_table[i].insn; i = (i + 1) & cse_mask) {
+		struct cse_entry *entry = &cse_table[i];
+
+		if (entry->hash != hash)
+			continue;
+		if (!entry->insn->bb)		// killed since
+			continue;
+		if (!insn_compare(entry->insn, insn))
+			return entry->insn;
 	}
-	if (domtree_dominates(b1, b2))
-		return cse_one_instruction(i2, i1);
-
-	if (domtree_dominates(b2, b1))
-		return cse_one_instruction(i1, i2);
-
-	/* No direct dominance - but we could try to find a common ancestor.. */
-	common = trivial_common_parent(b1, b2);
-	if (common) {
-		i1 = cse_one_instruction(i2, i1);
-		remove_instruction(&b1->insns, i1, 1);
-		insert_last_instruction(common, i1);
-	} else {
-		i1 = i2;
+	*slot = i;
+	return NULL;
+}
+
+static void cse_insert(struct instruction *insn, unsigned long hash, unsigned long slot)
+{
+	cse_table[slot].hash = hash;
+	cse_table[slot].insn = insn;
+	cse_stack[cse_top++] = slot;
+}
+
+static struct basic_block *single_parent(struct basic_block *bb)
+{
+	if (bb_list_size(bb->parents) != 1)
+		return NULL;
+	return first_basic_block(bb->parents);
+}
+
+///
+// CSE two identical instructions in sibling blocks
+//
+// The dominance doesn't help when two identical instructions are in
+// blocks having the same single parent. In this case, one of them is
+// moved to the end of the parent and the other is removed.
+// @return: the instruction kept or NULL if none was found.
+static struct instruction *cse_siblings(struct instruction *insn, unsigned long hash)
+{
+	struct basic_block *parent = single_parent(insn->bb);
+	unsigned long i;
+
+	if (!parent)
+		return NULL;
+
+	for (i = hash & cse_mask; sibling_table[i].insn; i = (i + 1) & cse_mask) {
+		struct instruction *def = sibling_table[i].insn;
+		struct basic_block *bb = def->bb;
+
+		if (sibling_table[i].hash != hash)
+			continue;
+		if (!bb || bb == insn->bb || bb == parent)
+			continue;
+		if (single_parent(bb) != parent)
+			continue;
+		if (insn_compare(def, insn))
+			continue;
+
+		cse_one_instruction(insn, def);
+		delete_ptr_list_entry((struct ptr_list **)&bb->insns, def, 1);
+		insert_last_instruction(parent, def);
+		// its users may now be simplified (if-conversion, ...)
+		queue_users(def->target);
+		return def;
 	}
+	sibling_table[i].hash = hash;
+	sibling_table[i].insn = insn;
+	sibling_slots[sibling_nr++] = i;
+	return NULL;
+}
 
-	return i1;
+static void cse_bb(struct basic_block *bb, unsigned long generation)
+{
+	unsigned long top = cse_top;
+	struct basic_block *child;
+	struct instruction *insn;
+
+	bb->generation = generation;
+	FOR_EACH_PTR(bb->insns, insn) {
+		struct instruction *def;
+		unsigned long hash, slot = 0;
+
+		if (!insn->bb)
+			continue;
+		hash = insn_hash(insn);
+		if (!hash)
+			continue;
+		def = cse_lookup(insn, hash, &slot);
+		if (def)
+			cse_one_instruction(insn, def);
+		else if (!cse_siblings(insn, hash))
+			cse_insert(insn, hash, slot);
+	} END_FOR_EACH_PTR(insn);
+
+	FOR_EACH_PTR(bb->doms, child) {
+		if (child->generation != generation)
+			cse_bb(child, generation);
+	} END_FOR_EACH_PTR(child);
+
+	// leave the scope of this block
+	while (cse_top > top) {
+		struct cse_entry *entry = &cse_table[cse_stack[--cse_top]];
+		entry->hash = 0;
+		entry->insn = NULL;
+	}
 }
 
 void cse_eliminate(struct entrypoint *ep)
 {
-	int i;
-
-	for (i = 0; i < INSN_HASH_SIZE; i++) {
-		struct instruction_list **list = insn_hash_table + i;
-		if (*list) {
-			if (instruction_list_size(*list) > 1) {
-				struct instruction *insn, *last;
-
-				sort_instruction_list(list);
-
-				last = NULL;
-				FOR_EACH_PTR(*list, insn) {
-					if (!insn->bb)
-						continue;
-					if (last) {
-						if (!insn_compare(last, insn))
-							insn = try_to_cse(ep, last, insn);
-					}
-					last = insn;
-				} END_FOR_EACH_PTR(insn);
-			}
-			free_ptr_list(list);
-		}
-	}
+	struct basic_block *bb;
+	unsigned long generation;
+	unsigned long nr = 0;
+
+	// the dominance tree must reflect the last changes in the CFG
+	domtree_update(ep);
+	generation = ++bb_generation;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		nr += instruction_list_size(bb->insns);
+	} END_FOR_EACH_PTR(bb);
+	cse_table_init(nr);
+
+	cse_bb(ep->entry->bb, generation);
+
+	// blocks created since the dominance tree was built
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (bb->generation != generation)
+			cse_bb(bb, generation);
+	} END_FOR_EACH_PTR(bb);
+	cse_table_clear();
 }
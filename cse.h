@@ -5,7 +5,6 @@ struct instruction;
 struct entrypoint;
 
 /* cse.c */
-void cse_collect(struct instruction *insn);
 void cse_eliminate(struct entrypoint *ep);
 
 #endif
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: MIT
+//
+// SSA-based dead code elimination
+//
+// Mark and sweep: the instructions with some side-effect are live,
+// as well as the instructions defining the operands of a live one,
+// and everything else is dead. Unlike the removal done when the last
+// use of a pseudo is killed, this also catches the dead cycles going
+// through phi-nodes, like a counter incremented in a loop but never
+// used otherwise.
+//
+// The branches are always kept live: removing them would need the
+// control dependences and the CFG is cleaned up elsewhere anyway.
+
+#include <stdlib.h>
+#include "dce.h"
+#include "lib.h"
+#include "linearize.h"
+#include "flow.h"
+#include "summary.h"
+
+
+// the live instructions whose operands are not yet marked
+static struct instruction **stack;
+static unsigned int stack_nr, stack_max;
+
+static bool has_side_effect(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_ENTRY:
+	case OP_TERMINATOR ... OP_TERMINATOR_END:
+	case OP_STORE:
+	case OP_ASM:
+	case OP_CONTEXT:
+	case OP_RANGE:
+	case OP_INLINED_CALL:
+		return true;
+	case OP_CALL:
+		return !call_is_pure(insn);
+	case OP_LOAD:
+		return insn->is_volatile;
+	default:
+		return false;
+	}
+}
+
+static void mark_live(struct instruction *insn)
+{
+	if (insn->marked)
+		return;
+	insn->marked = 1;
+	if (stack_nr == stack_max) {
+		stack_max = stack_max ? 2 * stack_max : 256;
+		stack = realloc(stack, stack_max * sizeof(*stack));
+		if (!stack)
+			die("out of memory for the DCE");
+	}
+	stack[stack_nr++] = insn;
+}
+
+static void mark_pseudo(pseudo_t p)
+{
+	if (p && (p->type == PSEUDO_REG || p->type == PSEUDO_PHI))
+		mark_live(p->def);
+}
+
+static void mark_pseudo_list(struct pseudo_list *list)
+{
+	pseudo_t p;
+
+	FOR_EACH_PTR(list, p) {
+		mark_pseudo(p);
+	} END_FOR_EACH_PTR(p);
+}
+
+static void mark_operands(struct instruction *insn)
+{
+	struct asm_constraint *con;
+
+	switch (insn->opcode) {
+	case OP_SEL:
+	case OP_RANGE:
+	case OP_FMADD:
+		mark_pseudo(insn->src3);
+		/* fall through */
+	case OP_BINARY ... OP_BINCMP_END:
+		mark_pseudo(insn->src2);
+		/* fall through */
+	case OP_UNOP ... OP_UNOP_END:
+	case OP_SLICE:
+	case OP_SYMADDR:
+	case OP_PHISOURCE:
+	case OP_COPY:
+	case OP_CBR:
+	case OP_SWITCH:
+	case OP_COMPUTEDGOTO:
+	case OP_RET:
+	case OP_LOAD:
+		mark_pseudo(insn->src1);
+		break;
+	case OP_STORE:
+		mark_pseudo(insn->src);
+		mark_pseudo(insn->target);
+		break;
+	case OP_PHI:
+		mark_pseudo_list(insn->phi_list);
+		break;
+	case OP_CALL:
+		mark_pseudo(insn->func);
+		/* fall through */
+	case OP_INLINED_CALL:
+		mark_pseudo_list(insn->arguments);
+		break;
+	case OP_ASM:
+		FOR_EACH_PTR(insn->asm_rules->inputs, con) {
+			mark_pseudo(con->pseudo);
+		} END_FOR_EACH_PTR(con);
+		// the memory outputs use their address
+		FOR_EACH_PTR(insn->asm_rules->outputs, con) {
+			mark_pseudo(con->pseudo);
+		} END_FOR_EACH_PTR(con);
+		break;
+	}
+}
+
+///
+// remove the instructions without side-effect whose result is,
+// directly or not, never used by one with some side-effect.
+// @return: REPEAT_CSE if something was removed, 0 otherwise.
+int dce(struct entrypoint *ep)
+{
+	struct instruction *insn;
+	struct basic_block *bb;
+	int changed = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (insn->bb && has_side_effect(insn))
+				mark_live(insn);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	while (stack_nr)
+		mark_operands(stack[--stack_nr]);
+
+	// the dead instructions only use dead or live pseudos, so
+	// killing them won't touch a live instruction.
+	FOR_EACH_PTR(ep->bbs, bb) {
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
+			if (insn->marked) {
+				insn->marked = 0;
+				continue;
+			}
+			changed |= kill_instruction(insn);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	return changed;
+}
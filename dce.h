@@ -0,0 +1,8 @@
+#ifndef DCE_H
+#define DCE_H
+
+struct entrypoint;
+
+int dce(struct entrypoint *ep);
+
+#endif
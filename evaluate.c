@@ -1993,40 +1993,6 @@ static struct symbol *evaluate_preop(struct expression *expr)
 	return ctype;
 }
 
-static struct symbol *find_identifier(struct ident *ident, struct symbol_list *_list, int *offset)
-{
-	struct ptr_list *head = (struct ptr_list *)_list;
-	struct ptr_list *list = head;
-
-	if (!head)
-		return NULL;
-	do {
-		int i;
-		for (i = 0; i < list->nr; i++) {
-			struct symbol *sym = (struct symbol *) list->list[i];
-			if (sym->ident) {
-				if (sym->ident != ident)
-					continue;
-				*offset = sym->offset;
-				return sym;
-			} else {
-				struct symbol *ctype = sym->ctype.base_type;
-				struct symbol *sub;
-				if (!ctype)
-					continue;
-				if (ctype->type != SYM_UNION && ctype->type != SYM_STRUCT)
-					continue;
-				sub = find_identifier(ident, ctype->symbol_list, offset);
-				if (!sub)
-					continue;
-				*offset += sym->offset;
-				return sub;
-			}	
-		}
-	} while ((list = list->next) != head);
-	return NULL;
-}
-
 static struct expression *evaluate_offset(struct expression *expr, unsigned long offset)
 {
 	struct expression *add;
@@ -2092,7 +2058,7 @@ static struct symbol *evaluate_member_dereference(struct expression *expr)
 		return NULL;
 	}
 	offset = 0;
-	member = find_identifier(ident, ctype->symbol_list, &offset);
+	member = find_struct_member(ctype, ident, &offset);
 	if (!member) {
 		const char *type = ctype->type == SYM_STRUCT ? "struct" : "union";
 		const char *name = "<unnamed>";
@@ -2483,7 +2449,7 @@ static struct expression *check_designators(struct expression *e,
 				err = "field name not in struct or union";
 				break;
 			}
-			ctype = find_identifier(e->expr_ident, ctype->symbol_list, &offset);
+			ctype = find_struct_member(ctype, e->expr_ident, &offset);
 			if (!ctype) {
 				err = "unknown field name in";
 				break;
@@ -3234,7 +3200,7 @@ static struct symbol *evaluate_offsetof(struct expression *expr)
 			return NULL;
 		}
 
-		field = find_identifier(expr->ident, ctype->symbol_list, &offset);
+		field = find_struct_member(ctype, expr->ident, &offset);
 		if (!field) {
 			expression_error(expr, "unknown member");
 			return NULL;
@@ -3570,11 +3536,13 @@ void evaluate_symbol_list(struct symbol_list *list)
 {
 	struct symbol *sym;
 
+	start_timer(TIMER_EVALUATE);
 	FOR_EACH_PTR(list, sym) {
 		has_error &= ~ERROR_CURR_PHASE;
 		evaluate_symbol(sym);
 		check_duplicates(sym);
 	} END_FOR_EACH_PTR(sym);
+	stop_timer(TIMER_EVALUATE);
 }
 
 static struct symbol *evaluate_return_expression(struct statement *stmt)
@@ -607,55 +607,48 @@ static int expand_addressof(struct expression *expr)
 	return expand_expression(expr->unop);
 }
 
-///
-// lookup the type of a struct's memeber at the requested offset
-static struct symbol *find_member(struct symbol *sym, int offset)
-{
-	struct ptr_list *head, *list;
-
-	head = (struct ptr_list *) sym->symbol_list;
-	list = head;
-	if (!head)
-		return NULL;
-	do {
-		int nr = list->nr;
-		int i;
-		for (i = 0; i < nr; i++) {
-			struct symbol *ent = (struct symbol *) list->list[i];
-			int curr = ent->offset;
-			if (curr == offset)
-				return ent;
-			if (curr > offset)
-				return NULL;
-		}
-	} while ((list = list->next) != head);
-	return NULL;
-}
-
 ///
 // lookup a suitable default initializer value at the requested offset
+//
+// The offset can be in nested arrays or structs but only the members
+// at the start of a struct or at an offset given by the initializer
+// are found.
 static struct expression *default_initializer(struct symbol *sym, int offset)
 {
 	static struct expression value;
-	struct symbol *type;
+	struct symbol *type = NULL;
 
-redo:
-	switch (sym->type) {
-	case SYM_NODE:
-		sym = sym->ctype.base_type;
-		goto redo;
-	case SYM_STRUCT:
-		type = find_member(sym, offset);
-		if (!type)
-			return NULL;
-		break;
-	case SYM_ARRAY:
-		type = sym->ctype.base_type;
-		break;
-	default:
-		return NULL;
+	for (;;) {
+		struct symbol *base;
+		int size;
+
+		switch (sym->type) {
+		case SYM_NODE:
+			sym = sym->ctype.base_type;
+			continue;
+		case SYM_STRUCT:
+			type = find_member_at(sym, offset);
+			if (!type)
+				return NULL;
+			offset -= type->offset;
+			break;
+		case SYM_ARRAY:
+			type = sym->ctype.base_type;
+			base = type->type == SYM_NODE ? type->ctype.base_type : type;
+			size = bits_to_bytes(type->bit_size > 0 ? type->bit_size : base->bit_size);
+			if (size <= 0)
+				return NULL;
+			offset %= size;
+			break;
+		default:
+			goto done;
+		}
+		sym = type;
 	}
 
+done:
+	if (!type || offset)
+		return NULL;
 	if (is_integral_type(type))
 		value.type = EXPR_VALUE;
 	else if (is_float_type(type))
@@ -667,36 +660,328 @@ redo:
 	return &value;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Lookup of the values given by an initializer
+//
+// The value at some offset of an initialized object is found by walking
+// its whole initializer, nested lists and positional expressions
+// included. Once an initializer has been read INIT_INDEX_READS times,
+// its values are instead recorded, with their offset, in an array sorted
+// on the offsets and each read becomes a binary search.
+//
+// When several values are given for the same place, the last one wins
+// (C11 6.7.9p19), a nested list included: its missing members are then
+// zero. But the lists are sorted once expanded, so the order between a
+// nested list and the entries of its parent can't always be known. A
+// value is thus only trusted if:
+// * no other value overlaps it, except the ones at the same offset,
+//   which are then in the same list and come before it;
+// * the only nested lists covering it are the ones containing it.
+
+// at least 2: the first read counts the values for the index
+#define INIT_INDEX_READS	2
+
+struct init_item {
+	unsigned int offset;		// in bits
+	unsigned int end;		// in bits
+	unsigned int order;		// in the lists, only used for sorting
+	unsigned int depth;		// number of nested lists containing it
+	struct expression *expr;	// a value, an EXPR_POS for a range or a nested list
+};
+
+struct init_entry {
+	unsigned int offset;		// in bits
+	unsigned int reach;		// the end of this entry and of the previous ones
+	struct expression *expr;	// NULL if the value can't be trusted
+};
+
+struct init_index {
+	unsigned int nr;
+	struct init_entry entries[];
+};
+
+struct init_walk {
+	unsigned int nr;		// the items walked
+
+	// for the index, filled in offset order
+	struct init_index *index;
+	unsigned int max_entries;
+	unsigned int last;		// the offset of the last item
+	unsigned int *ends;		// the nested lists covering it
+	unsigned int nr_ends, max_ends;
+	bool unsorted;
+	// or for the items to be sorted first
+	struct init_item *items;
+	unsigned int max_items;
+
+	// for a single read
+	unsigned long offset, end;
+	struct init_item value;
+	unsigned int covering;		// the nested lists covering the offset
+	unsigned int values;
+	bool overlap;
+};
+
+DECLARE_ALLOCATOR(init_index);
+ALLOCATOR(init_index, "initializer indexes");
+
+static unsigned long bit_range(const struct expression *expr);
+
+static void *grow_array(void *array, unsigned int *max, size_t size)
+{
+	*max = *max ? 2 * *max : 64;
+	array = realloc(array, *max * size);
+	if (!array)
+		die("out of memory for the initializer index");
+	return array;
+}
+
+static void index_init_item(struct init_walk *walk, struct init_item *item)
+{
+	struct init_index *index = walk->index;
+	struct init_entry *entry;
+	unsigned int i;
+
+	if (item->offset < walk->last) {
+		walk->unsorted = true;
+		return;
+	}
+	walk->last = item->offset;
+	while (walk->nr_ends && walk->ends[walk->nr_ends - 1] <= item->offset)
+		walk->nr_ends--;
+
+	if (item->expr->type == EXPR_INITIALIZER) {
+		// the values just given at this offset are overridden
+		for (i = index->nr; i-- && index->entries[i].offset == item->offset; )
+			index->entries[i].expr = NULL;
+		if (walk->nr_ends == walk->max_ends)
+			walk->ends = grow_array(walk->ends, &walk->max_ends, sizeof(*walk->ends));
+		walk->ends[walk->nr_ends++] = item->end;
+		return;
+	}
+
+	if (index->nr == walk->max_entries) {
+		// the initializer changed since its values were counted
+		walk->unsorted = true;
+		return;
+	}
+	entry = &index->entries[index->nr++];
+	entry->offset = item->offset;
+	entry->reach = item->end;
+	if (index->nr > 1 && entry[-1].reach > entry->reach)
+		entry->reach = entry[-1].reach;
+	entry->expr = walk->nr_ends > item->depth ? NULL : item->expr;
+}
+
+static void add_init_item(struct init_walk *walk, struct init_item *item)
+{
+	walk->nr++;
+	if (walk->items) {
+		if (walk->nr > walk->max_items)
+			walk->items = grow_array(walk->items, &walk->max_items, sizeof(*item));
+		walk->items[walk->nr - 1] = *item;
+		return;
+	}
+	if (walk->index) {
+		if (!walk->unsorted)
+			index_init_item(walk, item);
+		return;
+	}
+
+	if (item->expr->type == EXPR_INITIALIZER) {
+		if (item->offset <= walk->offset && walk->offset < item->end)
+			walk->covering++;
+		return;
+	}
+	walk->values++;
+	if (item->offset == walk->offset) {
+		walk->value = *item;
+	} else if (item->offset < walk->offset) {
+		if (item->end > walk->offset)
+			walk->overlap = true;
+	} else if (item->offset < walk->end) {
+		walk->overlap = true;
+	}
+}
+
+static void walk_initializer(struct init_walk *walk, struct expression *expr, unsigned long base, unsigned int depth);
+
+static void walk_init_entry(struct init_walk *walk, struct expression *expr, unsigned long base, unsigned int depth)
+{
+	struct init_item item;
+	long size;
+
+	if (expr->type == EXPR_POS && expr->init_nr == 1) {
+		base += bytes_to_bits(expr->init_offset);
+		if (expr->init_expr)
+			walk_init_entry(walk, expr->init_expr, base, depth);
+		return;
+	}
+	if (!expr->ctype)
+		return;
+
+	size = expr->ctype->bit_size;
+	if (expr->type == EXPR_INITIALIZER) {
+		// a nested list: its members not given are zero
+		item.offset = base + bytes_to_bits(expr->list_offset);
+		item.end = size > 0 ? item.offset + size : UINT_MAX;
+	} else if (expr->type == EXPR_POS) {
+		item.offset = base + bytes_to_bits(expr->init_offset);
+		item.end = item.offset + bit_range(expr);
+	} else {
+		item.offset = base + expr->ctype->bit_offset;
+		item.end = size > 0 ? item.offset + size : UINT_MAX;
+	}
+	item.order = walk->nr;
+	item.depth = depth;
+	item.expr = expr;
+	if (item.end > item.offset)
+		add_init_item(walk, &item);
+
+	if (expr->type == EXPR_INITIALIZER)
+		walk_initializer(walk, expr, base, depth + 1);
+}
+
+static void walk_initializer(struct init_walk *walk, struct expression *expr, unsigned long base, unsigned int depth)
+{
+	struct expression *entry;
+
+	FOR_EACH_PTR(expr->expr_list, entry) {
+		walk_init_entry(walk, entry, base, depth);
+	} END_FOR_EACH_PTR(entry);
+}
+
+static int cmp_init_item(const void *a, const void *b)
+{
+	const struct init_item *i1 = a;
+	const struct init_item *i2 = b;
+
+	if (i1->offset != i2->offset)
+		return i1->offset < i2->offset ? -1 : 1;
+	return i1->order < i2->order ? -1 : i1->order > i2->order;
+}
+
+static struct init_index *build_init_index(struct expression *init)
+{
+	struct init_walk walk = { };
+	unsigned int i, values = 0;
+
+	walk.max_entries = init->init_values;
+	walk.index = __alloc_init_index(walk.max_entries * sizeof(struct init_entry));
+	walk_initializer(&walk, init, 0, 0);
+	if (!walk.unsorted)
+		goto done;
+
+	// not walked in the offsets order, sort the items first
+	walk.nr = 0;
+	walk.items = grow_array(NULL, &walk.max_items, sizeof(struct init_item));
+	walk_initializer(&walk, init, 0, 0);
+	qsort(walk.items, walk.nr, sizeof(struct init_item), cmp_init_item);
+	for (i = 0; i < walk.nr; i++)
+		values += walk.items[i].expr->type != EXPR_INITIALIZER;
+	if (values > walk.max_entries) {
+		walk.max_entries = values;
+		walk.index = __alloc_init_index(values * sizeof(struct init_entry));
+	}
+	walk.index->nr = 0;
+	walk.last = walk.nr_ends = 0;
+	walk.unsorted = false;
+	for (i = 0; i < walk.nr; i++)
+		index_init_item(&walk, &walk.items[i]);
+	free(walk.items);
+done:
+	free(walk.ends);
+	return walk.index;
+}
+
+///
+// find the value given by an initializer at some offset
+// @offset: the offset, in bits
+// @size: the size of the read, in bits
+// @covered: set if something is given at this offset, even if its
+//	value can't be known
+// @return: the value at this offset, if known
+static struct expression *initializer_value(struct expression *init, unsigned long offset, unsigned long size, bool *covered)
+{
+	struct init_index *index = init->init_index;
+	struct init_entry *entry;
+	unsigned int lo, hi;
+
+	if (!index && ++init->init_reads < INIT_INDEX_READS) {
+		struct init_walk walk = { .offset = offset, .end = offset + size };
+
+		walk_initializer(&walk, init, 0, 0);
+		init->init_values = walk.values;
+		*covered = walk.overlap || walk.value.expr;
+		if (walk.overlap || !walk.value.expr)
+			return NULL;
+		if (walk.covering > walk.value.depth)
+			return NULL;
+		return walk.value.expr->type == EXPR_POS ? NULL : walk.value.expr;
+	}
+	if (!index)
+		index = init->init_index = build_init_index(init);
+
+	lo = 0;
+	hi = index->nr;
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (index->entries[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (hi = lo; hi < index->nr && index->entries[hi].offset == offset; hi++)
+		;
+	*covered = true;
+	if (lo > 0 && index->entries[lo - 1].reach > offset)
+		return NULL;
+	if (hi < index->nr && index->entries[hi].offset < offset + size)
+		return NULL;
+	if (hi == lo) {
+		*covered = false;
+		return NULL;
+	}
+	entry = &index->entries[hi - 1];
+	if (!entry->expr || entry->expr->type == EXPR_POS)
+		return NULL;
+	return entry->expr;
+}
+
 /*
  * Look up a trustable initializer value at the requested offset.
  *
  * Return NULL if no such value can be found or statically trusted.
  */
-static struct expression *constant_symbol_value(struct symbol *sym, int offset)
+static struct expression *constant_symbol_value(struct symbol *sym, int offset, struct symbol *ctype)
 {
 	struct expression *value;
 
-	if (sym->ctype.modifiers & MOD_ACCESS)
+	if (!is_integral_type(ctype) && !is_float_type(ctype))
+		return NULL;
+	if (sym->ctype.modifiers & MOD_WEAK)	// may be replaced at link time
 		return NULL;
+	if (sym->ctype.modifiers & MOD_ACCESS) {
+		// a const object can't be changed, even if its address is taken
+		if (!(ctype->ctype.modifiers & MOD_CONST))
+			return NULL;
+		if ((ctype->ctype.modifiers | sym->ctype.modifiers) & MOD_VOLATILE)
+			return NULL;
+	}
 	value = sym->initializer;
 	if (!value)
 		return NULL;
 	if (value->type == EXPR_INITIALIZER) {
-		struct expression *entry;
-		FOR_EACH_PTR(value->expr_list, entry) {
-			if (entry->type != EXPR_POS) {
-				if (offset)
-					continue;
-				return entry;
-			}
-			if (entry->init_offset < offset)
-				continue;
-			if (entry->init_offset > offset)
-				break;
-			return entry->init_expr;
-		} END_FOR_EACH_PTR(entry);
+		bool covered;
 
-		value = default_initializer(sym, offset);
+		if (offset < 0 || bytes_to_bits(offset) + ctype->bit_size > sym->bit_size)
+			return NULL;
+		if (sym->bit_size > UINT_MAX)	// too big for the index
+			return NULL;
+		value = initializer_value(value, bytes_to_bits(offset), ctype->bit_size, &covered);
+		if (!value && !covered)
+			value = default_initializer(sym, offset);
 	}
 	return value;
 }
@@ -734,7 +1019,7 @@ static int expand_dereference(struct expression *expr)
 	if (unop->type == EXPR_SYMBOL) {
 		struct symbol *sym = unop->symbol;
 		struct symbol *ctype = expr->ctype;
-		struct expression *value = constant_symbol_value(sym, offset);
+		struct expression *value = constant_symbol_value(sym, offset, ctype);
 
 		/* Const symbol with a constant initializer? */
 		if (value && value->ctype) {
@@ -975,6 +1260,7 @@ static int expand_pos_expression(struct expression *expr)
 		case EXPR_INITIALIZER: {
 			struct expression *reuse = nested, *entry;
 			*expr = *nested;
+			expr->list_offset += offset;
 			FOR_EACH_PTR(expr->expr_list, entry) {
 				if (entry->type == EXPR_POS) {
 					entry->init_offset += offset;
@@ -1045,6 +1331,20 @@ static int compare_expressions(const void *_a, const void *_b)
 
 static void sort_expression_list(struct expression_list **list)
 {
+	struct expression *expr;
+	unsigned long last = 0;
+
+	// the entries are most often already in order, check it first
+	FOR_EACH_PTR(*list, expr) {
+		unsigned long pos = bit_offset(expr);
+
+		if (pos < last)
+			goto unsorted;
+		last = pos;
+	} END_FOR_EACH_PTR(expr);
+	return;
+
+unsorted:
 	sort_list((struct ptr_list **)list, compare_expressions);
 }
 
@@ -1201,12 +1501,14 @@ int expand_symbol(struct symbol *sym)
 	if (!base_type)
 		return 0;
 
+	start_timer(TIMER_EXPAND);
 	retval = expand_expression(sym->initializer);
 	/* expand the body of the symbol */
 	if (base_type->type == SYM_FN) {
 		if (base_type->stmt)
 			expand_statement(base_type->stmt);
 	}
+	stop_timer(TIMER_EXPAND);
 	return retval;
 }
 
@@ -32,6 +32,7 @@
 #include "symbol.h"
 
 struct expression_list;
+struct init_index;
 
 enum expression_type {
 	EXPR_VALUE = 1,
@@ -229,7 +230,12 @@ struct expression {
 			struct symbol *label_symbol;
 		};
 		// EXPR_INITIALIZER
-		struct expression_list *expr_list;
+		struct {
+			struct expression_list *expr_list;
+			struct init_index *init_index;
+			unsigned int list_offset;	// in bytes, once moved by expand
+			unsigned int init_reads, init_values;
+		};
 		// EXPR_IDENTIFIER
 		struct /* ident_expr */ {
 			int offset;
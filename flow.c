@@ -18,6 +18,8 @@
 #include "linearize.h"
 #include "simplify.h"
 #include "flow.h"
+#include "flowgraph.h"
+#include "summary.h"
 #include "target.h"
 
 unsigned long bb_generation;
@@ -102,6 +104,8 @@ static int rewrite_branch(struct basic_block *bb,
 	replace_bb_in_list(&bb->children, old, new, 1);
 	remove_bb_from_list(&old->parents, bb, 1);
 	add_bb(&new->parents, bb);
+	domtree_insert_edge(bb, new);
+	domtree_delete_edge(bb, old);
 	return 1;
 }
 
@@ -276,7 +280,8 @@ static int bb_has_side_effects(struct basic_block *bb)
 			continue;
 		switch (insn->opcode) {
 		case OP_CALL:
-			/* FIXME! This should take "const" etc into account */
+			if (call_is_pure(insn))
+				continue;
 			return 1;
 
 		case OP_LOAD:
@@ -399,6 +404,7 @@ void convert_instruction_target(struct instruction *insn, pseudo_t src)
 	target = insn->target;
 	if (target == src)
 		return;
+	queue_users(target);
 	FOR_EACH_PTR(target->users, pu) {
 		if (*pu->userp != VOID) {
 			assert(*pu->userp == target);
@@ -410,7 +416,7 @@ void convert_instruction_target(struct instruction *insn, pseudo_t src)
 	target->users = NULL;
 }
 
-static int overlapping_memop(struct instruction *a, struct instruction *b)
+int overlapping_memop(struct instruction *a, struct instruction *b)
 {
 	unsigned int a_start = bytes_to_bits(a->offset);
 	unsigned int b_start = bytes_to_bits(b->offset);
@@ -447,7 +453,15 @@ static inline int distinct_symbols(pseudo_t a, pseudo_t b)
 int dominates(struct instruction *insn, struct instruction *dom, int local)
 {
 	switch (dom->opcode) {
-	case OP_CALL: case OP_ENTRY:
+	case OP_CALL:
+		if (local)
+			return 0;
+		// a load can only be changed by a write and a store only
+		// matters to a read
+		if (insn->opcode == OP_LOAD ? !call_writes_memory(dom) : !call_reads_memory(dom))
+			return 0;
+		return -1;
+	case OP_ENTRY:
 		return local ? 0 : -1;
 	case OP_LOAD: case OP_STORE:
 		break;
@@ -516,7 +530,7 @@ static void kill_dead_stores_bb(pseudo_t pseudo, unsigned long generation, struc
 			}
 			break;
 		case OP_CALL:
-			if (!local)
+			if (!local && call_reads_memory(insn))
 				return;
 		default:
 			continue;
@@ -541,7 +555,8 @@ void check_access(struct instruction *insn)
 		struct symbol *sym = pseudo->sym;
 
 		if (sym->bit_size > 0 && (offset < 0 || bit > sym->bit_size)) {
-			if (insn->tainted)
+			// already checked in the inlined function
+			if (insn->tainted || insn->inlined)
 				return;
 			warning(insn->pos, "invalid access %s '%s' (%d %d)",
 				offset < 0 ? "below" : "past the end of",
@@ -635,13 +650,16 @@ void kill_bb(struct basic_block *bb)
 
 	FOR_EACH_PTR(bb->children, child) {
 		remove_bb_from_list(&child->parents, bb, 0);
+		domtree_delete_edge(bb, child);
 	} END_FOR_EACH_PTR(child);
 	bb->children = NULL;
 
 	FOR_EACH_PTR(bb->parents, parent) {
 		remove_bb_from_list(&parent->children, bb, 0);
+		domtree_delete_edge(parent, bb);
 	} END_FOR_EACH_PTR(parent);
 	bb->parents = NULL;
+	domtree_remove_bb(bb);
 }
 
 void kill_unreachable_bbs(struct entrypoint *ep)
@@ -820,6 +838,7 @@ int convert_to_jump(struct instruction *insn, struct basic_block *target)
 		}
 		DELETE_CURRENT_PTR(child);
 		remove_bb_from_list(&child->parents, bb, 1);
+		domtree_delete_edge(bb, child);
 		changed |= REPEAT_CFG_CLEANUP;
 	} END_FOR_EACH_PTR(child);
 	PACK_PTR_LIST(&bb->children);
@@ -898,6 +917,7 @@ static int merge_bb(struct basic_block *top, struct basic_block *bot)
 	if (top == bot)
 		return 0;
 
+	domtree_merge_bb(top, bot);
 	top->children = bot->children;
 	bot->children = NULL;
 	bot->parents = NULL;
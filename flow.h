@@ -42,6 +42,7 @@ static inline int kill_instruction_force(struct instruction *insn)
 
 void check_access(struct instruction *insn);
 int dominates(struct instruction *insn, struct instruction *dom, int local);
+int overlapping_memop(struct instruction *a, struct instruction *b);
 
 extern void vrfy_flow(struct entrypoint *ep);
 extern int pseudo_in_list(struct pseudo_list *list, pseudo_t pseudo);
@@ -114,40 +114,41 @@ static void debug_domtree(struct entrypoint *ep)
 	} END_FOR_EACH_PTR(bb);
 }
 
-void domtree_build(struct entrypoint *ep)
+static inline bool in_domtree(struct basic_block *bb)
 {
-	struct basic_block *entry = ep->entry->bb;
-	struct basic_block **doms;
-	struct basic_block *bb;
-	unsigned int size;
-	int max_level = 0;
-	int changed;
-
-	// First calculate the (reverse) postorder.
-	// This will give use us:
-	//	- the links to do a reverse postorder traversal
-	//	- the order number for each block
-	size = cfg_postorder(ep);
+	return bb->ep && (bb->idom || bb == bb->ep->entry->bb);
+}
 
-	// initialize the dominators array
-	doms = calloc(size, sizeof(*doms));
-	assert(entry->postorder_nr == size-1);
-	doms[size-1] = entry;
+///
+// compute the immediate dominators of the BBs given in reverse
+// postorder, the first one being the root.
+// Only the parents labeled with @gen are taken in account.
+// @return: 0 if OK, -1 if some parent from elsewhere was found.
+static int compute_idoms(struct basic_block_list *rpo, struct basic_block *doms[], unsigned long gen)
+{
+	struct basic_block *root = first_basic_block(rpo);
+	int changed;
 
+	doms[root->postorder_nr] = root;
 	do {
 		struct basic_block *b;
 
 		changed = 0;
-		FOR_EACH_PTR(ep->bbs, b) {
+		FOR_EACH_PTR(rpo, b) {
 			struct basic_block *p;
 			int bnr = b->postorder_nr;
 			struct basic_block *new_idom = NULL;
 
-			if (b == entry)
-				continue;	// ignore entry node
+			if (b == root)
+				continue;	// ignore the root
 
 			FOR_EACH_PTR(b->parents, p) {
 				unsigned int pnr = p->postorder_nr;
+				if (p->generation != gen) {
+					if (in_domtree(p))
+						return -1;
+					continue;	// unreachable
+				}
 				if (!doms[pnr])
 					continue;
 				if (!new_idom) {
@@ -165,11 +166,34 @@ void domtree_build(struct entrypoint *ep)
 			}
 		} END_FOR_EACH_PTR(b);
 	} while (changed);
+	return 0;
+}
 
+void domtree_build(struct entrypoint *ep)
+{
+	struct basic_block *entry = ep->entry->bb;
+	struct basic_block **doms;
+	struct basic_block *bb;
+	unsigned int size;
+	int max_level = 0;
+
+	// forget the old tree, even for the BBs about to be dropped
 	FOR_EACH_PTR(ep->bbs, bb) {
 		free_ptr_list(&bb->doms);
+		bb->idom = NULL;
 	} END_FOR_EACH_PTR(bb);
 
+	// First calculate the (reverse) postorder.
+	// This will give use us:
+	//	- the links to do a reverse postorder traversal
+	//	- the order number for each block
+	size = cfg_postorder(ep);
+
+	// initialize the dominators array
+	doms = calloc(size, sizeof(*doms));
+	assert(entry->postorder_nr == size-1);
+	compute_idoms(ep->bbs, doms, bb_generation);
+
 	// set the idom links
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct basic_block *idom = doms[bb->postorder_nr];
@@ -192,12 +216,304 @@ void domtree_build(struct entrypoint *ep)
 			max_level = level;
 	} END_FOR_EACH_PTR(bb);
 	ep->dom_levels = max_level + 1;
+	ep->dom_valid = 1;
+	ep->dom_root = NULL;
+	ep->dom_budget = size;
 
 	free(doms);
 	if (dbg_domtree)
 		debug_domtree(ep);
 }
 
+///
+// Incremental updates
+// ^^^^^^^^^^^^^^^^^^^
+// The changes to the CFG are not applied to the dominance tree right
+// away, only the subtree which may be affected is tracked: the one
+// rooted at the nearest common dominator of all the modified edges
+// (in the tree as it was before the changes). Nothing outside this
+// subtree can be affected as long as all its BBs stay reachable and
+// only the modified edges are inside it, so the dominators can then
+// be recomputed on this subtree alone. Otherwise the whole tree is
+// rebuilt.
+//
+// Note: after these updates ::dom_level only increase along the
+// tree, they are not the exact depth anymore.
+//
+// Walking up a deep tree for each modified edge can cost more than
+// rebuilding it, so the walks share a budget of as many steps as there
+// are BBs in the tree: once exhausted, the tree is simply invalidated.
+
+static struct basic_block *nearest_dominator(struct entrypoint *ep,
+	struct basic_block *a, struct basic_block *b)
+{
+	while (a != b) {
+		if (!a || !b || !ep->dom_budget)
+			return NULL;
+		ep->dom_budget--;
+		if (a->dom_level >= b->dom_level)
+			a = a->idom;
+		else
+			b = b->idom;
+	}
+	return a;
+}
+
+static void domtree_invalidate(struct entrypoint *ep)
+{
+	ep->dom_valid = 0;
+	ep->dom_root = NULL;
+}
+
+static void domtree_pending(struct entrypoint *ep, struct basic_block *a, struct basic_block *b)
+{
+	struct basic_block *root = nearest_dominator(ep, a, b);
+
+	if (root && ep->dom_root)
+		root = nearest_dominator(ep, root, ep->dom_root);
+	if (!root)
+		return domtree_invalidate(ep);
+	ep->dom_root = root;
+}
+
+void domtree_insert_edge(struct basic_block *from, struct basic_block *to)
+{
+	struct entrypoint *ep = from->ep;
+	struct basic_block *nca;
+
+	if (!ep || !ep->dom_valid)
+		return;
+	if (!in_domtree(from))
+		return;			// nothing changes for unreachable BBs
+	if (!in_domtree(to))
+		return domtree_invalidate(ep);
+	if (ep->dom_root)
+		return domtree_pending(ep, from, to);
+
+	// nothing changes if @to's idom already dominates @from
+	nca = nearest_dominator(ep, from, to);
+	if (!nca)
+		return domtree_invalidate(ep);
+	if (nca == to || nca == to->idom)
+		return;
+	ep->dom_root = nca;
+}
+
+void domtree_delete_edge(struct basic_block *from, struct basic_block *to)
+{
+	struct entrypoint *ep = from->ep;
+	struct basic_block *parent;
+	struct basic_block *nca;
+
+	if (!ep || !ep->dom_valid)
+		return;
+	if (!in_domtree(from) || !in_domtree(to))
+		return;
+	if (ep->dom_root)
+		return domtree_pending(ep, from, to);
+
+	// nothing changes for a back-edge or if @to
+	// can still be reached from its idom.
+	nca = nearest_dominator(ep, from, to);
+	if (!nca)
+		return domtree_invalidate(ep);
+	if (nca == to)
+		return;
+	FOR_EACH_PTR(to->parents, parent) {
+		if (parent == from || parent == to->idom)
+			return;
+	} END_FOR_EACH_PTR(parent);
+	ep->dom_root = nca;
+}
+
+void domtree_remove_bb(struct basic_block *bb)
+{
+	struct entrypoint *ep = bb->ep;
+	struct basic_block *idom = bb->idom;
+	struct basic_block *child;
+
+	if (!ep || !ep->dom_valid || !idom)
+		return;
+
+	// the BBs it dominated are now dominated by its own idom
+	FOR_EACH_PTR(bb->doms, child) {
+		child->idom = idom;
+		add_bb(&idom->doms, child);
+	} END_FOR_EACH_PTR(child);
+	free_ptr_list(&bb->doms);
+	remove_bb_from_list(&idom->doms, bb, 1);
+	bb->idom = NULL;
+	if (ep->dom_root == bb)
+		ep->dom_root = idom;
+}
+
+///
+// to be called before merging @bot into @top
+void domtree_merge_bb(struct basic_block *top, struct basic_block *bot)
+{
+	struct entrypoint *ep = top->ep;
+	struct basic_block *child;
+
+	if (!ep || !ep->dom_valid || !in_domtree(top))
+		return;
+	if (ep->dom_root || bot->idom != top || bb_list_size(bot->parents) != 1) {
+		// the edges from @bot are moved to @top
+		domtree_pending(ep, top, bot);
+		FOR_EACH_PTR(bot->children, child) {
+			if (in_domtree(child))
+				domtree_pending(ep, top, child);
+		} END_FOR_EACH_PTR(child);
+		if (!ep->dom_valid)
+			return;
+	}
+	domtree_remove_bb(bot);
+}
+
+static void mark_subtree(struct basic_block *bb, unsigned long gen, struct basic_block_list **list)
+{
+	struct basic_block *child;
+
+	bb->generation = gen;
+	add_bb(list, bb);
+	FOR_EACH_PTR(bb->doms, child) {
+		mark_subtree(child, gen, list);
+	} END_FOR_EACH_PTR(child);
+}
+
+static void label_subtree(struct basic_block *bb, unsigned long in, struct cfg_info *info)
+{
+	struct basic_block *child;
+
+	bb->generation = info->gen;
+	FOR_EACH_PTR_REVERSE(bb->children, child) {
+		if (child->generation == in)
+			label_subtree(child, in, info);
+	} END_FOR_EACH_PTR_REVERSE(child);
+
+	bb->postorder_nr = info->nr++;
+	add_bb(&info->list, bb);
+}
+
+///
+// Can the BBs of the subtree not reachable anymore be simply dropped?
+// Not if they had an edge going out of the subtree: the dominators
+// of its target may then have changed.
+static bool can_drop(struct basic_block_list *subtree, unsigned long in, unsigned long gen)
+{
+	struct basic_block *bb;
+
+	FOR_EACH_PTR(subtree, bb) {
+		struct basic_block *child;
+
+		if (bb->generation != in)
+			continue;
+		FOR_EACH_PTR(bb->children, child) {
+			if (child->generation == in || child->generation == gen)
+				continue;
+			if (in_domtree(child))
+				return false;
+		} END_FOR_EACH_PTR(child);
+	} END_FOR_EACH_PTR(bb);
+	return true;
+}
+
+static int update_subtree(struct entrypoint *ep, struct basic_block *root)
+{
+	unsigned long in = ++bb_generation;
+	struct cfg_info info = { .gen = ++bb_generation, };
+	struct basic_block_list *subtree = NULL;
+	struct basic_block_list *rpo = NULL;
+	struct basic_block **doms = NULL;
+	unsigned int size, level;
+	struct basic_block *bb;
+	int rc = -1;
+
+	mark_subtree(root, in, &subtree);
+	label_subtree(root, in, &info);
+	size = bb_list_size(subtree);
+	if (info.nr != size && !can_drop(subtree, in, info.gen))
+		goto out;
+
+	// forget the old subtree
+	FOR_EACH_PTR(subtree, bb) {
+		free_ptr_list(&bb->doms);
+		if (bb != root)
+			bb->idom = NULL;
+	} END_FOR_EACH_PTR(bb);
+
+	reverse_bbs(&rpo, info.list);
+	doms = calloc(info.nr, sizeof(*doms));
+	rc = compute_idoms(rpo, doms, info.gen);
+	if (rc)
+		goto out;
+
+	level = ep->dom_levels - 1;
+	FOR_EACH_PTR(rpo, bb) {
+		struct basic_block *idom = doms[bb->postorder_nr];
+
+		if (bb == root)
+			continue;
+		bb->idom = idom;
+		add_bb(&idom->doms, bb);
+		bb->dom_level = idom->dom_level + 1;
+		if (level < bb->dom_level)
+			level = bb->dom_level;
+	} END_FOR_EACH_PTR(bb);
+	ep->dom_levels = level + 1;
+
+out:
+	free(doms);
+	free_ptr_list(&rpo);
+	free_ptr_list(&info.list);
+	free_ptr_list(&subtree);
+	return rc;
+}
+
+///
+// check the dominance tree against a full recalculation
+static void domtree_verify(struct entrypoint *ep)
+{
+	struct cfg_info info = { .gen = ++bb_generation, };
+	struct basic_block_list *rpo = NULL;
+	struct basic_block **doms;
+	struct basic_block *bb;
+
+	label_postorder(ep->entry->bb, &info);
+	reverse_bbs(&rpo, info.list);
+	doms = calloc(info.nr, sizeof(*doms));
+	compute_idoms(rpo, doms, info.gen);
+	FOR_EACH_PTR(rpo, bb) {
+		struct basic_block *idom = doms[bb->postorder_nr];
+
+		if (bb == ep->entry->bb)
+			continue;
+		if (bb->idom != idom)
+			sparse_error(bb->pos, "%s: wrong idom for %s: %s instead of %s",
+				show_ident(ep->name->ident), show_label(bb),
+				show_label(bb->idom), show_label(idom));
+		else if (bb->dom_level <= idom->dom_level)
+			sparse_error(bb->pos, "%s: wrong dom level for %s",
+				show_ident(ep->name->ident), show_label(bb));
+	} END_FOR_EACH_PTR(bb);
+	free(doms);
+	free_ptr_list(&rpo);
+	free_ptr_list(&info.list);
+}
+
+void domtree_update(struct entrypoint *ep)
+{
+	struct basic_block *root = ep->dom_root;
+
+	if (ep->dom_valid && !root)
+		goto out;
+	ep->dom_root = NULL;
+	if (!ep->dom_valid || update_subtree(ep, root))
+		return domtree_build(ep);
+out:
+	if (dbg_domtree_check)
+		domtree_verify(ep);
+}
+
 // dt_dominates - does BB a dominates BB b?
 bool domtree_dominates(struct basic_block *a, struct basic_block *b)
 {
@@ -23,6 +23,20 @@ int cfg_postorder(struct entrypoint *ep);
 //	- its level in the dominance tree (::dom_level)
 void domtree_build(struct entrypoint *ep);
 
+///
+// Keep the dominance tree up to date with the changes in the CFG.
+// The changes are only recorded and applied by domtree_update().
+void domtree_insert_edge(struct basic_block *from, struct basic_block *to);
+void domtree_delete_edge(struct basic_block *from, struct basic_block *to);
+void domtree_merge_bb(struct basic_block *top, struct basic_block *bot);
+void domtree_remove_bb(struct basic_block *bb);
+
+///
+// Update the dominance tree after some changes in the CFG.
+// Only the part of the tree affected by the changes is recalculated,
+// if possible.
+void domtree_update(struct entrypoint *ep);
+
 ///
 // Test the dominance between two basic blocks.
 // @a: the basic block expected to dominate
@@ -224,6 +224,8 @@ static struct expression * copy_expression(struct expression *expr)
 		struct expression *entry;
 		expr = dup_expression(expr);
 		expr->expr_list = NULL;
+		expr->init_index = NULL;
+		expr->init_reads = 0;
 		FOR_EACH_PTR(list, entry) {
 			add_expression(&expr->expr_list, copy_expression(entry));
 		} END_FOR_EACH_PTR(entry);
@@ -0,0 +1,696 @@
+// SPDX-License-Identifier: MIT
+//
+// Inlining of small functions in the IR
+//
+// Once linearized and optimized, the IR of each small static function
+// is recorded as a compact body, independent of the IR allocators.
+// Before being optimized, the functions linearized later then have
+// their direct calls to these functions replaced by a copy of this
+// body, so that the simplifications and the context checking can see
+// through the trivial helpers and accessors.
+//
+// Since the bodies are recorded after their own calls have been
+// inlined, the small helpers are inlined bottom-up. Only functions
+// defined before their callers can be inlined and functions with
+// a context annotation are never inlined, their annotation being
+// what the callers are checked against.
+//
+// The cost of a body is the number of its instructions, not counting
+// the ones which are free or only used to glue the BBs together. Calls
+// cost more since inlining a call by another one removes no barrier.
+
+#include <stdlib.h>
+#include "inliner.h"
+#include "lib.h"
+#include "linearize.h"
+#include "flow.h"
+
+unsigned long inlined_calls;
+
+struct inline_ref {
+	enum pseudo_type type;
+	int nr;				// the argument or the defining instruction
+	union {
+		long long value;
+		struct symbol *sym;
+	};
+};
+
+struct inline_insn {
+	struct instruction insn;	// a copy, without its links into the IR
+	int bb;				// the index of its BB
+	int bb_true, bb_false;		// the index of the targets of a branch
+	int ops, nr_ops;		// its operands, in ::refs
+	int types, nr_types;		// the ::fntypes of a call, in ::types
+	int has_target;
+	struct ident *ident;		// the name of its target
+};
+
+struct inline_bb {
+	struct position pos;
+	int edges;			// its parents then its children, in ::edges
+	int nr_parents, nr_children;
+};
+
+struct inline_body {
+	int cost;
+	int nr_args;
+	struct symbol **args;		// the type of the arguments
+	int nr_bbs, nr_insns;
+	struct inline_bb *bbs;
+	struct inline_insn *insns;
+	struct inline_ref *refs;
+	int *edges;
+	struct symbol **types;
+	int ret;			// the index of the return
+};
+
+///
+// get the operands of an instruction, except its phi-sources or arguments.
+// @return: the number of operands or -1 if the instruction can't be inlined.
+static int get_operands(struct instruction *insn, pseudo_t *ops[3])
+{
+	switch (insn->opcode) {
+	case OP_BR: case OP_UNREACH: case OP_NOP:
+	case OP_SETFVAL: case OP_CONTEXT:
+	case OP_PHI:
+		return 0;
+	case OP_RET:
+		if (!insn->src)
+			return 0;
+		/* fall through */
+	case OP_UNOP ... OP_UNOP_END:
+	case OP_SYMADDR: case OP_SLICE:
+	case OP_LOAD:
+		ops[0] = &insn->src;
+		return 1;
+	case OP_CBR:
+		ops[0] = &insn->cond;
+		return 1;
+	case OP_PHISOURCE:
+		ops[0] = &insn->phi_src;
+		return 1;
+	case OP_CALL:
+		ops[0] = &insn->func;
+		return 1;
+	case OP_STORE:
+		ops[0] = &insn->src;
+		ops[1] = &insn->target;
+		return 2;
+	case OP_SEL: case OP_FMADD: case OP_RANGE:
+		ops[2] = &insn->src3;
+		ops[1] = &insn->src2;
+		ops[0] = &insn->src1;
+		return 3;
+	case OP_BINARY ... OP_BINARY_END:
+	case OP_FPCMP ... OP_FPCMP_END:
+	case OP_BINCMP ... OP_BINCMP_END:
+		ops[1] = &insn->src2;
+		ops[0] = &insn->src1;
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+static int insn_cost(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_BR: case OP_RET: case OP_NOP:
+	case OP_PHI: case OP_PHISOURCE:
+	case OP_CONTEXT:
+		return 0;
+	case OP_CALL:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+static bool skip_insn(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_ENTRY:
+	case OP_INLINED_CALL:
+	case OP_DEATHNOTE:
+		return true;
+	default:
+		return !insn->bb;
+	}
+}
+
+static bool inline_candidate(struct symbol *sym)
+{
+	struct symbol *fn = sym->ctype.base_type;
+
+	if (!(sym->ctype.modifiers & MOD_STATIC))
+		return false;
+	if (sym->ctype.modifiers & MOD_NORETURN)
+		return false;
+	if (sym->ctype.contexts)
+		return false;
+	return !fn->variadic;
+}
+
+static bool record_ref(struct inline_ref *ref, pseudo_t p)
+{
+	ref->type = p->type;
+	switch (p->type) {
+	case PSEUDO_VOID:
+	case PSEUDO_UNDEF:
+		return true;
+	case PSEUDO_VAL:
+		ref->value = p->value;
+		return true;
+	case PSEUDO_ARG:
+		ref->nr = p->nr;
+		return true;
+	case PSEUDO_SYM:
+		// the local variables would be shared between the copies
+		if (!(p->sym->ctype.modifiers & (MOD_STATIC | MOD_NONLOCAL)))
+			return false;
+		ref->sym = p->sym;
+		return true;
+	case PSEUDO_REG:
+	case PSEUDO_PHI:
+		if (!p->priv)
+			return false;
+		ref->nr = (long) p->priv - 1;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void free_body(struct inline_body *body)
+{
+	free(body->args);
+	free(body->bbs);
+	free(body->insns);
+	free(body->refs);
+	free(body->edges);
+	free(body->types);
+	free(body);
+}
+
+static struct inline_body *alloc_body(int nr_args, int nr_bbs, int nr_insns,
+	int nr_refs, int nr_edges, int nr_types)
+{
+	struct inline_body *body = calloc(1, sizeof(*body));
+
+	if (!body)
+		goto oom;
+	body->args = calloc(nr_args + 1, sizeof(*body->args));
+	body->bbs = calloc(nr_bbs, sizeof(*body->bbs));
+	body->insns = calloc(nr_insns, sizeof(*body->insns));
+	body->refs = calloc(nr_refs + 1, sizeof(*body->refs));
+	body->edges = calloc(nr_edges + 1, sizeof(*body->edges));
+	body->types = calloc(nr_types + 1, sizeof(*body->types));
+	if (body->args && body->bbs && body->insns && body->refs && body->edges && body->types)
+		return body;
+oom:
+	die("out of memory for the inliner");
+}
+
+static bool fill_body(struct inline_body *body, struct entrypoint *ep)
+{
+	struct basic_block *bb, *child, *parent;
+	struct instruction *insn;
+	int nr_bbs = 0, nr_insns = 0, nr_refs = 0, nr_edges = 0, nr_types = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct inline_bb *ibb = &body->bbs[nr_bbs++];
+
+		ibb->pos = bb->pos;
+		ibb->edges = nr_edges;
+		FOR_EACH_PTR(bb->parents, parent) {
+			body->edges[nr_edges++] = (long) parent->priv - 1;
+			ibb->nr_parents++;
+		} END_FOR_EACH_PTR(parent);
+		FOR_EACH_PTR(bb->children, child) {
+			body->edges[nr_edges++] = (long) child->priv - 1;
+			ibb->nr_children++;
+		} END_FOR_EACH_PTR(child);
+
+		FOR_EACH_PTR(bb->insns, insn) {
+			struct inline_insn *t;
+			pseudo_t *ops[3], *tops[3];
+			struct symbol *type;
+			pseudo_t p;
+			int i, n;
+
+			if (skip_insn(insn))
+				continue;
+			t = &body->insns[nr_insns++];
+			t->insn = *insn;
+			t->insn.bb = NULL;
+			t->insn.queued = 0;
+			t->insn.marked = 0;
+			t->insn.target = NULL;
+			t->bb = nr_bbs - 1;
+			if (insn->opcode == OP_RET)
+				body->ret = nr_insns - 1;
+			if (has_target(insn) && insn->target != VOID) {
+				t->has_target = 1;
+				t->ident = insn->target->ident;
+			}
+			t->ops = nr_refs;
+
+			n = get_operands(insn, ops);
+			get_operands(&t->insn, tops);
+			for (i = 0; i < n; i++) {
+				if (!record_ref(&body->refs[nr_refs++], *ops[i]))
+					return false;
+				*tops[i] = NULL;
+			}
+			switch (insn->opcode) {
+			case OP_BR:
+				t->bb_true = (long) insn->bb_true->priv - 1;
+				t->insn.bb_true = NULL;
+				break;
+			case OP_CBR:
+				t->bb_true = (long) insn->bb_true->priv - 1;
+				t->bb_false = (long) insn->bb_false->priv - 1;
+				t->insn.bb_true = NULL;
+				t->insn.bb_false = NULL;
+				break;
+			case OP_PHI:
+				FOR_EACH_PTR(insn->phi_list, p) {
+					if (!record_ref(&body->refs[nr_refs++], p))
+						return false;
+				} END_FOR_EACH_PTR(p);
+				t->insn.phi_list = NULL;
+				t->insn.phi_var = NULL;
+				break;
+			case OP_PHISOURCE:
+				t->insn.phi_node = NULL;
+				break;
+			case OP_CALL:
+				FOR_EACH_PTR(insn->arguments, p) {
+					if (!record_ref(&body->refs[nr_refs++], p))
+						return false;
+				} END_FOR_EACH_PTR(p);
+				t->types = nr_types;
+				FOR_EACH_PTR(insn->fntypes, type) {
+					body->types[nr_types++] = type;
+				} END_FOR_EACH_PTR(type);
+				t->nr_types = nr_types - t->types;
+				t->insn.arguments = NULL;
+				t->insn.fntypes = NULL;
+				break;
+			}
+			t->nr_ops = nr_refs - t->ops;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	return true;
+}
+
+static struct inline_body *record_body(struct entrypoint *ep)
+{
+	struct inline_body *body = NULL;
+	struct basic_block *bb;
+	struct instruction *insn;
+	struct symbol_list *args;
+	struct symbol *arg;
+	int nr_bbs = 0, nr_insns = 0, nr_refs = 0, nr_edges = 0, nr_types = 0;
+	int nr_ret = 0, cost = 0;
+
+	// number the BBs and the values, check & size everything
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->priv = (void *)(long) ++nr_bbs;
+		nr_edges += bb_list_size(bb->parents) + bb_list_size(bb->children);
+		FOR_EACH_PTR(bb->insns, insn) {
+			pseudo_t *ops[3];
+			int n;
+
+			if (skip_insn(insn))
+				continue;
+			n = get_operands(insn, ops);
+			if (n < 0)
+				goto out;
+			cost += insn_cost(insn);
+			if (cost > finline_ir_limit)
+				goto out;
+			nr_insns++;
+			nr_refs += n;
+			switch (insn->opcode) {
+			case OP_RET:
+				nr_ret++;
+				break;
+			case OP_PHI:
+				nr_refs += pseudo_list_size(insn->phi_list);
+				break;
+			case OP_CALL:
+				nr_refs += pseudo_list_size(insn->arguments);
+				nr_types += symbol_list_size(insn->fntypes);
+				break;
+			}
+			if (has_target(insn) && insn->target != VOID)
+				insn->target->priv = (void *)(long) nr_insns;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	if (nr_ret != 1)
+		goto out;
+	if (first_basic_block(ep->bbs) != ep->entry->bb || ep->entry->bb->parents)
+		goto out;
+
+	args = ep->name->ctype.base_type->arguments;
+	body = alloc_body(symbol_list_size(args), nr_bbs, nr_insns, nr_refs, nr_edges, nr_types);
+	body->cost = cost;
+	body->nr_bbs = nr_bbs;
+	body->nr_insns = nr_insns;
+	FOR_EACH_PTR(args, arg) {
+		body->args[body->nr_args++] = arg;
+	} END_FOR_EACH_PTR(arg);
+	if (!fill_body(body, ep)) {
+		free_body(body);
+		body = NULL;
+	}
+
+out:
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->priv = NULL;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (insn->bb && has_target(insn) && insn->target)
+				insn->target->priv = NULL;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	return body;
+}
+
+void record_inline_body(struct entrypoint *ep)
+{
+	struct symbol *sym = ep->name;
+
+	if (!ep->entry || !inline_candidate(sym))
+		return;
+	sym->inline_body = record_body(ep);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Inlining of the calls
+
+struct inline_copy {
+	struct entrypoint *ep;
+	struct inline_body *body;
+	pseudo_t *args;
+	struct basic_block **bbs;
+	struct instruction **insns;
+};
+
+static pseudo_t copy_ref(struct inline_copy *copy, struct inline_ref *ref)
+{
+	switch (ref->type) {
+	case PSEUDO_VOID:
+		return VOID;
+	case PSEUDO_UNDEF:
+		return undef_pseudo();
+	case PSEUDO_VAL:
+		return value_pseudo(ref->value);
+	case PSEUDO_SYM:
+		return symbol_pseudo(copy->ep, ref->sym);
+	case PSEUDO_ARG:
+		return copy->args[ref->nr - 1];
+	default:
+		return copy->insns[ref->nr]->target;
+	}
+}
+
+static struct inline_body *callee_body(struct instruction *call)
+{
+	struct inline_body *body;
+	struct symbol *sym, *type;
+	pseudo_t func = call->func;
+	int nr = 0;
+
+	if (func->type != PSEUDO_SYM)
+		return NULL;
+	sym = func->sym;
+	if (sym->definition)
+		sym = sym->definition;
+	if (sym->type != SYM_NODE || !(body = sym->inline_body))
+		return NULL;
+	if (pseudo_list_size(call->arguments) != body->nr_args)
+		return NULL;
+	if (symbol_list_size(call->fntypes) != body->nr_args + 1)
+		return NULL;
+	if (call->target != VOID && !body->insns[body->ret].nr_ops)
+		return NULL;
+
+	// the arguments must already have the expected type
+	FOR_EACH_PTR(call->fntypes, type) {
+		struct symbol *arg;
+
+		if (!nr++)
+			continue;	// the function's type
+		arg = body->args[nr - 2];
+		if (!type || type->bit_size != arg->bit_size)
+			return NULL;
+		if (is_float_type(type) != is_float_type(arg))
+			return NULL;
+	} END_FOR_EACH_PTR(type);
+	return body;
+}
+
+///
+// split the BB of a call, the instructions after the call going
+// in a new BB, and return this new BB.
+static struct basic_block *split_after(struct entrypoint *ep, struct instruction *call)
+{
+	struct basic_block *bb = call->bb;
+	struct basic_block *cont = alloc_basic_block(ep, call->pos);
+	struct basic_block *child;
+	struct instruction *insn;
+	int after = 0;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		// the phi-sources must stay at the end of the BB
+		if (after || insn->opcode == OP_PHISOURCE) {
+			DELETE_CURRENT_PTR(insn);
+			add_instruction(&cont->insns, insn);
+			if (insn->bb)
+				insn->bb = cont;
+		} else if (insn == call) {
+			after = 1;
+		}
+	} END_FOR_EACH_PTR(insn);
+	PACK_PTR_LIST(&bb->insns);
+
+	cont->children = bb->children;
+	bb->children = NULL;
+	FOR_EACH_PTR(cont->children, child) {
+		replace_bb_in_list(&child->parents, bb, cont, 0);
+	} END_FOR_EACH_PTR(child);
+	return cont;
+}
+
+static void add_edge(struct basic_block *from, struct basic_block *to)
+{
+	add_bb(&from->children, to);
+	add_bb(&to->parents, from);
+}
+
+static struct instruction *alloc_branch(struct basic_block *bb, struct basic_block *target, struct position pos)
+{
+	struct instruction *br = __alloc_instruction(0);
+
+	br->opcode = OP_BR;
+	br->pos = pos;
+	br->bb_true = target;
+	br->bb = bb;
+	add_instruction(&bb->insns, br);
+	return br;
+}
+
+static void copy_insn(struct inline_copy *copy, int nr)
+{
+	struct inline_insn *t = &copy->body->insns[nr];
+	struct instruction *insn = copy->insns[nr];
+	struct inline_ref *refs = &copy->body->refs[t->ops];
+	pseudo_t *ops[3];
+	int i, n;
+
+	if (t->insn.opcode == OP_RET)
+		return;
+	n = get_operands(insn, ops);
+	for (i = 0; i < n; i++)
+		use_pseudo(insn, copy_ref(copy, &refs[i]), ops[i]);
+
+	switch (insn->opcode) {
+	case OP_CBR:
+		insn->bb_false = copy->bbs[t->bb_false];
+		/* fall through */
+	case OP_BR:
+		insn->bb_true = copy->bbs[t->bb_true];
+		break;
+	case OP_PHI:
+		for (; i < t->nr_ops; i++) {
+			pseudo_t phi = copy_ref(copy, &refs[i]);
+
+			if (phi == VOID)
+				add_pseudo(&insn->phi_list, VOID);
+			else
+				link_phi(insn, phi);
+		}
+		break;
+	case OP_CALL:
+		for (; i < t->nr_ops; i++) {
+			pseudo_t arg = copy_ref(copy, &refs[i]);
+
+			use_pseudo(insn, arg, add_pseudo(&insn->arguments, arg));
+		}
+		for (i = 0; i < t->nr_types; i++)
+			add_symbol(&insn->fntypes, copy->body->types[t->types + i]);
+		break;
+	}
+}
+
+///
+// replace a call by a copy of the callee's body
+// @return: the BB following the copy.
+static struct basic_block *inline_call(struct entrypoint *ep, struct instruction *call, struct inline_body *body)
+{
+	struct basic_block *bb = call->bb;
+	struct basic_block *cont;
+	struct basic_block_list *placed = NULL;
+	struct inline_copy copy;
+	struct inline_insn *ret;
+	pseudo_t arg, retval;
+	int i, j;
+
+	copy.ep = ep;
+	copy.body = body;
+	copy.args = malloc((body->nr_args + 1) * sizeof(*copy.args));
+	copy.bbs = malloc(body->nr_bbs * sizeof(*copy.bbs));
+	copy.insns = malloc(body->nr_insns * sizeof(*copy.insns));
+	if (!copy.args || !copy.bbs || !copy.insns)
+		die("out of memory for the inliner");
+	i = 0;
+	FOR_EACH_PTR(call->arguments, arg) {
+		copy.args[i++] = arg;
+	} END_FOR_EACH_PTR(arg);
+
+	cont = split_after(ep, call);
+
+	// the BBs and their edges
+	for (i = 0; i < body->nr_bbs; i++) {
+		copy.bbs[i] = alloc_basic_block(ep, body->bbs[i].pos);
+		add_bb(&placed, copy.bbs[i]);
+	}
+	for (i = 0; i < body->nr_bbs; i++) {
+		struct inline_bb *ibb = &body->bbs[i];
+		int *edges = &body->edges[ibb->edges];
+		struct basic_block *new = copy.bbs[i];
+
+		for (j = 0; j < ibb->nr_parents; j++)
+			add_bb(&new->parents, copy.bbs[*edges++]);
+		for (j = 0; j < ibb->nr_children; j++)
+			add_bb(&new->children, copy.bbs[*edges++]);
+	}
+	add_bb(&placed, cont);
+
+	// the instructions and the values they define ...
+	for (i = 0; i < body->nr_insns; i++) {
+		struct inline_insn *t = &body->insns[i];
+		struct basic_block *new = copy.bbs[t->bb];
+		struct instruction *insn;
+
+		if (t->insn.opcode == OP_RET) {
+			insn = alloc_branch(new, cont, t->insn.pos);
+			add_edge(new, cont);
+		} else if (t->insn.opcode == OP_PHISOURCE) {
+			insn = alloc_phisrc(VOID, t->insn.type);
+			insn->pos = t->insn.pos;
+			insn->bb = new;
+			add_instruction(&new->insns, insn);
+		} else {
+			insn = __alloc_instruction(0);
+			*insn = t->insn;
+			insn->bb = new;
+			if (t->has_target) {
+				insn->target = alloc_pseudo(insn);
+				insn->target->ident = t->ident;
+			} else if (has_target(insn)) {
+				insn->target = VOID;
+			}
+			add_instruction(&new->insns, insn);
+		}
+		insn->inlined = 1;
+		copy.insns[i] = insn;
+	}
+	// ... then their operands
+	for (i = 0; i < body->nr_insns; i++)
+		copy_insn(&copy, i);
+
+	// the returned value replaces the call's result
+	ret = &body->insns[body->ret];
+	retval = ret->nr_ops ? copy_ref(&copy, &body->refs[ret->ops]) : VOID;
+	if (call->target != VOID)
+		convert_instruction_target(call, retval);
+	kill_instruction_force(call);
+	alloc_branch(bb, copy.bbs[0], call->pos);
+	add_edge(bb, copy.bbs[0]);
+
+	// where to place the new BBs
+	bb->priv = placed;
+
+	free(copy.args);
+	free(copy.bbs);
+	free(copy.insns);
+	inlined_calls++;
+	return cont;
+}
+
+///
+// place the BBs created by the inlining after the BB of their call
+static void place_bbs(struct entrypoint *ep)
+{
+	struct basic_block_list *bbs = NULL;
+	struct basic_block *bb;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct basic_block_list *placed;
+
+		add_bb(&bbs, bb);
+		while ((placed = bb->priv)) {
+			struct basic_block *new;
+
+			bb->priv = NULL;
+			FOR_EACH_PTR(placed, new) {
+				add_bb(&bbs, new);
+				bb = new;	// the last one continues the call's BB
+			} END_FOR_EACH_PTR(new);
+			free_ptr_list(&placed);
+		}
+	} END_FOR_EACH_PTR(bb);
+	free_ptr_list(&ep->bbs);
+	ep->bbs = bbs;
+}
+
+int inline_calls(struct entrypoint *ep)
+{
+	struct instruction_list *calls = NULL;
+	struct instruction *insn;
+	struct basic_block *bb;
+	int changed = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb || insn->opcode != OP_CALL)
+				continue;
+			if (callee_body(insn))
+				add_instruction(&calls, insn);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	if (!calls)
+		return 0;
+
+	FOR_EACH_PTR(calls, insn) {
+		inline_call(ep, insn, callee_body(insn));
+		changed = 1;
+	} END_FOR_EACH_PTR(insn);
+	free_ptr_list(&calls);
+
+	place_bbs(ep);
+	return changed;
+}
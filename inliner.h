@@ -0,0 +1,11 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+struct entrypoint;
+
+void record_inline_body(struct entrypoint *ep);
+int inline_calls(struct entrypoint *ep);
+
+extern unsigned long inlined_calls;
+
+#endif
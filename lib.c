@@ -330,8 +330,10 @@ static struct symbol_list *sparse_tokenstream(struct token *token)
 	}
 
 	// Parse the resulting C code
+	start_timer(TIMER_PARSE);
 	while (!eof_token(token))
 		token = external_declaration(token, &translation_unit_used_list, NULL);
+	stop_timer(TIMER_PARSE);
 	return translation_unit_used_list;
 }
 
@@ -114,14 +114,20 @@ extern int has_error;
 enum phase {
 	PASS__PARSE,
 	PASS__LINEARIZE,
+	PASS__INLINE,
 	PASS__MEM2REG,
+	PASS__SCCP,
+	PASS__DCE,
 	PASS__OPTIM,
 	PASS__FINAL,
 };
 
 #define	PASS_PARSE		(1UL << PASS__PARSE)
 #define	PASS_LINEARIZE		(1UL << PASS__LINEARIZE)
+#define	PASS_INLINE		(1UL << PASS__INLINE)
 #define	PASS_MEM2REG		(1UL << PASS__MEM2REG)
+#define	PASS_SCCP		(1UL << PASS__SCCP)
+#define	PASS_DCE		(1UL << PASS__DCE)
 #define	PASS_OPTIM		(1UL << PASS__OPTIM)
 #define	PASS_FINAL		(1UL << PASS__FINAL)
 
@@ -141,6 +147,49 @@ extern struct symbol_list *sparse_keep_tokens(char *filename);
 extern struct symbol_list *sparse(char *filename);
 extern void report_stats(void);
 
+/*
+ * Time spent in the different phases, reported by -ftime-report.
+ * The timers nest: time spent in an inner phase (like tokenizing
+ * an included file during preprocessing) isn't counted in the
+ * outer one.
+ */
+enum timer {
+	TIMER_TOKENIZE,
+	TIMER_PREPROCESS,
+	TIMER_PARSE,
+	TIMER_EVALUATE,
+	TIMER_EXPAND,
+	TIMER_LINEARIZE,
+	TIMER_INLINE,
+	TIMER_CFG,
+	TIMER_SSA,
+	TIMER_SCCP,
+	TIMER_DCE,
+	TIMER_MEMOPS,
+	TIMER_SIMPLIFY,
+	TIMER_CSE,
+	TIMER_LIVENESS,
+	TIMER_CHECK,
+	TIMER_NR,
+};
+
+extern void __start_timer(enum timer timer);
+extern void __stop_timer(enum timer timer);
+extern void start_function_timer(void);
+extern void stop_function_timer(struct symbol *sym);
+
+static inline void start_timer(enum timer timer)
+{
+	if (ftime_report)
+		__start_timer(timer);
+}
+
+static inline void stop_timer(enum timer timer)
+{
+	if (ftime_report)
+		__stop_timer(timer);
+}
+
 static inline int symbol_list_size(struct symbol_list *list)
 {
 	return ptr_list_size((struct ptr_list *)(list));
@@ -181,6 +230,11 @@ static inline struct instruction * delete_last_instruction(struct instruction_li
 	return undo_ptr_list_last((struct ptr_list **)head);
 }
 
+static inline struct basic_block *delete_last_basic_block(struct basic_block_list **head)
+{
+	return undo_ptr_list_last((struct ptr_list **)head);
+}
+
 static inline struct basic_block *first_basic_block(struct basic_block_list *head)
 {
 	return first_ptr_list((struct ptr_list *)head);
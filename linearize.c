@@ -20,6 +20,8 @@
 #include "expression.h"
 #include "linearize.h"
 #include "optimize.h"
+#include "inliner.h"
+#include "summary.h"
 #include "flow.h"
 #include "target.h"
 
@@ -64,7 +66,7 @@ static struct entrypoint *alloc_entrypoint(void)
 	return __alloc_entrypoint(0);
 }
 
-static struct basic_block *alloc_basic_block(struct entrypoint *ep, struct position pos)
+struct basic_block *alloc_basic_block(struct entrypoint *ep, struct position pos)
 {
 	static int nr;
 	struct basic_block *bb = __alloc_basic_block(0);
@@ -764,7 +766,7 @@ pseudo_t alloc_pseudo(struct instruction *def)
 	return pseudo;
 }
 
-static pseudo_t symbol_pseudo(struct entrypoint *ep, struct symbol *sym)
+pseudo_t symbol_pseudo(struct entrypoint *ep, struct symbol *sym)
 {
 	pseudo_t pseudo;
 
@@ -785,33 +787,112 @@ static pseudo_t symbol_pseudo(struct entrypoint *ep, struct symbol *sym)
 	return pseudo;
 }
 
+///
+// Interning of the value pseudos
+//
+// The table uses open addressing with linear probing and is keyed on
+// the whole value, the slot being given by the top bits of its product
+// with the golden ratio, so that masks or multiples of a power of two
+// are as well spread as small values. The load factor is kept under
+// 1/2. The table is emptied with the IR and is then also shrunk if it
+// was much too big for the last function.
+
+#define VAL_HASH_BITS	8
+
+static pseudo_t *value_table;
+static unsigned int value_bits;
+static unsigned long value_nr;
+static pseudo_t undef;
+
+unsigned long value_pseudo_hits, value_pseudo_misses;
+
+static inline unsigned long value_slot(long long val)
+{
+	return ((unsigned long long) val * 0x9e3779b97f4a7c15ULL) >> (64 - value_bits);
+}
+
+static void resize_value_table(unsigned int bits)
+{
+	unsigned long old_size = value_table ? 1UL << value_bits : 0;
+	pseudo_t *old = value_table;
+	unsigned long i;
+
+	value_table = calloc(1UL << bits, sizeof(*value_table));
+	if (!value_table)
+		die("out of memory");
+	value_bits = bits;
+	for (i = 0; i < old_size; i++) {
+		pseudo_t pseudo = old[i];
+		unsigned long mask = (1UL << bits) - 1;
+		unsigned long j;
+
+		if (!pseudo)
+			continue;
+		for (j = value_slot(pseudo->value); value_table[j]; j = (j + 1) & mask)
+			;
+		value_table[j] = pseudo;
+	}
+	free(old);
+}
+
+static void clear_value_pseudos(void)
+{
+	unsigned int bits = VAL_HASH_BITS;
+
+	undef = NULL;
+	if (!value_table)
+		return;
+	while ((1UL << bits) < 2 * value_nr)
+		bits++;
+	if (bits + 2 < value_bits) {
+		free(value_table);
+		value_table = NULL;
+		resize_value_table(bits);
+	} else {
+		memset(value_table, 0, sizeof(*value_table) << value_bits);
+	}
+	value_nr = 0;
+}
+
 pseudo_t value_pseudo(long long val)
 {
-#define MAX_VAL_HASH 64
-	static struct pseudo_list *prev[MAX_VAL_HASH];
-	int hash = val & (MAX_VAL_HASH-1);
-	struct pseudo_list **list = prev + hash;
+	unsigned long mask, i;
 	pseudo_t pseudo;
 
-	FOR_EACH_PTR(*list, pseudo) {
-		if (pseudo->value == val)
+	if (!value_table || 2 * (value_nr + 1) > 1UL << value_bits)
+		resize_value_table(value_table ? value_bits + 1 : VAL_HASH_BITS);
+
+	mask = (1UL << value_bits) - 1;
+	for (i = value_slot(val); (pseudo = value_table[i]); i = (i + 1) & mask) {
+		if (pseudo->value == val) {
+			value_pseudo_hits++;
 			return pseudo;
-	} END_FOR_EACH_PTR(pseudo);
+		}
+	}
+	value_pseudo_misses++;
 
 	pseudo = __alloc_pseudo(0);
 	pseudo->type = PSEUDO_VAL;
 	pseudo->value = val;
-	add_pseudo(list, pseudo);
+	value_table[i] = pseudo;
+	value_nr++;
 
 	/* Value pseudos have neither nr, usage nor def */
 	return pseudo;
 }
 
+///
+// the undefined value
+//
+// It has no usage, no def and nothing to distinguish two of them,
+// so a single one is shared by all the IR of a function.
 pseudo_t undef_pseudo(void)
 {
-	pseudo_t pseudo = __alloc_pseudo(0);
-	pseudo->type = PSEUDO_UNDEF;
-	return pseudo;
+	if (!undef) {
+		undef = __alloc_pseudo(0);
+		undef->type = PSEUDO_UNDEF;
+	}
+	return undef;
 }
 
 static pseudo_t argument_pseudo(struct entrypoint *ep, int nr)
@@ -1497,6 +1578,7 @@ static pseudo_t linearize_call_expression(struct entrypoint *ep, struct expressi
 	struct ctype *ctype = NULL;
 	struct symbol *fntype;
 	struct context *context;
+	bool noreturn;
 
 	if (!expr->ctype)
 		return VOID;
@@ -1535,6 +1617,7 @@ static pseudo_t linearize_call_expression(struct entrypoint *ep, struct expressi
 		retval = alloc_pseudo(insn);
 	insn->target = retval;
 	add_one_insn(ep, insn);
+	noreturn = call_noreturn(insn);
 
 	if (ctype) {
 		FOR_EACH_PTR(ctype->contexts, context) {
@@ -1561,8 +1644,10 @@ static pseudo_t linearize_call_expression(struct entrypoint *ep, struct expressi
 		} END_FOR_EACH_PTR(context);
 
 		if (ctype->modifiers & MOD_NORETURN)
-			add_unreachable(ep);
+			noreturn = true;
 	}
+	if (noreturn)
+		add_unreachable(ep);
 
 	return retval;
 }
@@ -2515,7 +2600,8 @@ static void late_warnings(struct entrypoint *ep)
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
-			if (!insn->bb)
+			// already checked in the inlined function
+			if (!insn->bb || insn->inlined)
 				continue;
 			if (insn->tainted)
 				check_tainted_insn(insn);
@@ -2575,13 +2661,84 @@ static struct entrypoint *linearize_fn(struct symbol *sym, struct symbol *base_t
 	add_one_insn(ep, ret);
 
 	optimize(ep);
+	if (fsummaries)
+		summarize_function(ep);
+	if (fpasses & PASS_INLINE)
+		record_inline_body(ep);
 	late_warnings(ep);
 	return ep;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Arena for the IR
+//
+// Everything the IR of a function is made of comes from a few
+// allocators, but the ptrlist's ones are shared with the parser.
+// So, all these allocators are marked before the linearization and
+// released once the IR is not needed anymore. This is only valid if
+// nothing outside the IR kept a reference to it: the entrypoint and
+// the pseudos of the symbols are unlinked and the table of the value
+// pseudos (and the undefined one) is emptied. Nothing must have been linearized before the
+// mark and kept after it since a symbol's pseudo could then have some
+// users in the released memory.
+
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist64);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist128);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist256);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist512);
+DECLARE_ALLOCATOR(ptrmap);
+
+#define IR_ALLOCATORS(X)	\
+	X(basic_block)		\
+	X(entrypoint)		\
+	X(instruction)		\
+	X(multijmp)		\
+	X(pseudo)		\
+	X(pseudo_user)		\
+	X(asm_rules)		\
+	X(asm_constraint)	\
+	X(ptrmap)		\
+	X(ptrlist64)		\
+	X(ptrlist128)		\
+	X(ptrlist256)		\
+	X(ptrlist512)
+
+struct ir_mark {
+#define IR_MARK(x)	struct allocation_mark x;
+	IR_ALLOCATORS(IR_MARK)
+};
+
+static struct ir_mark ir_mark;
+
+void mark_ir_allocations(void)
+{
+#define MARK_IR(x)	mark_##x##_alloc(&ir_mark.x);
+	IR_ALLOCATORS(MARK_IR)
+}
+
+///
+// release all the IR allocated since mark_ir_allocations()
+// @ep: the entrypoint linearized since then, if any
+void release_ir_allocations(struct entrypoint *ep)
+{
+	if (ep) {
+		pseudo_t pseudo;
+
+		FOR_EACH_PTR(ep->accesses, pseudo) {
+			pseudo->sym->pseudo = NULL;
+		} END_FOR_EACH_PTR(pseudo);
+		ep->name->ep = NULL;
+	}
+	clear_value_pseudos();
+
+#define RELEASE_IR(x)	release_##x##_alloc(&ir_mark.x);
+	IR_ALLOCATORS(RELEASE_IR)
+}
+
 struct entrypoint *linearize_symbol(struct symbol *sym)
 {
 	struct symbol *base_type;
+	struct entrypoint *ep;
 
 	if (!sym)
 		return NULL;
@@ -2589,9 +2746,13 @@ struct entrypoint *linearize_symbol(struct symbol *sym)
 	base_type = sym->ctype.base_type;
 	if (!base_type)
 		return NULL;
-	if (base_type->type == SYM_FN)
-		return linearize_fn(sym, base_type);
-	return NULL;
+	if (base_type->type != SYM_FN)
+		return NULL;
+
+	start_timer(TIMER_LINEARIZE);
+	ep = linearize_fn(sym, base_type);
+	stop_timer(TIMER_LINEARIZE);
+	return ep;
 }
 
 /*
@@ -91,6 +91,9 @@ struct instruction {
 	unsigned opcode:7,
 		 tainted:1,
 		 size:24;
+	unsigned queued:1;		// on the simplification worklist
+	unsigned marked:1;		// live, during the DCE
+	unsigned inlined:1;		// copied from an inlined function
 	struct basic_block *bb;
 	struct position pos;
 	struct symbol *type;
@@ -171,6 +174,7 @@ struct basic_block {
 	struct basic_block *idom;	/* link to the immediate dominator */
 	unsigned int nr;		/* unique id for label's names */
 	int dom_level;			/* level in the dominance tree */
+	unsigned int queued:1;		/* has instructions to simplify */
 	struct basic_block_list *doms;	/* list of BB idominated by this one */
 	struct pseudo_list *needs, *defines;
 	union {
@@ -195,6 +199,22 @@ static inline void add_bb(struct basic_block_list **list, struct basic_block *bb
 	add_ptr_list(list, bb);
 }
 
+extern bool worklist_active, worklist_pending;
+extern void queue_users(pseudo_t p);
+
+///
+// mark an instruction as needing to be simplified again
+// This is a no-op outside of the optimization loop or if the
+// instruction is dead.
+static inline void queue_instruction(struct instruction *insn)
+{
+	if (worklist_active && insn->bb) {
+		insn->queued = 1;
+		insn->bb->queued = 1;
+		worklist_pending = true;
+	}
+}
+
 static inline void add_instruction(struct instruction_list **list, struct instruction *insn)
 {
 	add_ptr_list(list, insn);
@@ -206,6 +226,7 @@ static inline void insert_last_instruction(struct basic_block *bb, struct instru
 	add_instruction(&bb->insns, insn);
 	add_instruction(&bb->insns, last);
 	insn->bb = bb;
+	queue_instruction(insn);
 }
 
 static inline void add_multijmp(struct multijmp_list **list, struct multijmp *multijmp)
@@ -274,6 +295,11 @@ static inline bool pseudo_user_list_empty(struct pseudo_user_list *list)
 	return ptr_list_empty((struct ptr_list *)list);
 }
 
+static inline bool has_target(struct instruction *insn)
+{
+	return opcode_table[insn->opcode].flags & OPF_TARGET;
+}
+
 static inline int has_users(pseudo_t p)
 {
 	return !pseudo_user_list_empty(p->users);
@@ -300,6 +326,7 @@ static inline struct pseudo_user *alloc_pseudo_user(struct instruction *insn, ps
 static inline void use_pseudo(struct instruction *insn, pseudo_t p, pseudo_t *pp)
 {
 	*pp = p;
+	queue_instruction(insn);
 	if (has_use_list(p))
 		add_pseudo_user_ptr(alloc_pseudo_user(insn, pp), &p->users);
 }
@@ -329,10 +356,14 @@ struct entrypoint {
 	struct basic_block *active;
 	struct instruction *entry;
 	unsigned int dom_levels;	/* max levels in the dom tree */
+	unsigned int dom_valid:1;	/* the dom tree has been built */
+	struct basic_block *dom_root;	/* the part of the dom tree to update */
+	unsigned int dom_budget;	/* steps left for the incremental updates */
 };
 
 extern void insert_select(struct basic_block *bb, struct instruction *br, struct instruction *phi, pseudo_t if_true, pseudo_t if_false);
 
+struct basic_block *alloc_basic_block(struct entrypoint *ep, struct position pos);
 struct instruction *alloc_phisrc(pseudo_t pseudo, struct symbol *type);
 struct instruction *alloc_phi_node(struct basic_block *bb, struct symbol *type, struct ident *ident);
 struct instruction *insert_phi_node(struct basic_block *bb, struct symbol *var);
@@ -340,10 +371,14 @@ void add_phi_node(struct basic_block *bb, struct instruction *phi_node);
 
 pseudo_t alloc_phi(struct basic_block *source, pseudo_t pseudo, struct symbol *type);
 pseudo_t alloc_pseudo(struct instruction *def);
+pseudo_t symbol_pseudo(struct entrypoint *ep, struct symbol *sym);
 pseudo_t value_pseudo(long long val);
 pseudo_t undef_pseudo(void);
+extern unsigned long value_pseudo_hits, value_pseudo_misses;
 
 struct entrypoint *linearize_symbol(struct symbol *sym);
+void mark_ir_allocations(void);
+void release_ir_allocations(struct entrypoint *ep);
 int unssa(struct entrypoint *ep);
 void show_entry(struct entrypoint *ep);
 void show_insn_entry(struct instruction *insn);
@@ -6,12 +6,16 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "liveness.h"
 #include "parse.h"
 #include "expression.h"
 #include "linearize.h"
 #include "flow.h"
+#include "bitmap.h"
+#include "lib.h"
 
 static void phi_defines(struct instruction * phi_node, pseudo_t target,
 	void (*defines)(struct basic_block *, pseudo_t))
@@ -138,14 +142,44 @@ static void track_instruction_usage(struct basic_block *bb, struct instruction *
 }
 
 
-static int liveness_changed;
+//
+// The liveness is computed one pseudo at a time on a dense numbering
+// of the pseudos and of the BBs of the current entrypoint: starting
+// from the BBs using a pseudo, its need is propagated upward to the
+// parents until a BB defining it is reached. The per-BB state for the
+// current pseudo is kept in bitmaps indexed by the BB's number.
+//
+// While the numbering is in use, the number of a pseudo (plus one) is
+// kept in its ->priv and the number of a BB in its ->priv;
+// release_numbering() restores them to NULL.
+//
+static pseudo_t *live_pseudos;
+static unsigned int live_nr, live_max;
+
+struct live_ref {
+	unsigned int pseudo;
+	unsigned int bb;
+};
+
+static struct live_ref *live_uses, *live_defs;
+static unsigned int uses_nr, uses_max, defs_nr, defs_max;
+
+static void *grow_array(void *array, unsigned int *max, size_t size)
+{
+	*max = *max ? 2 * *max : 256;
+	array = realloc(array, *max * size);
+	if (!array)
+		die("out of memory for the liveness");
+	return array;
+}
 
-static void add_pseudo_exclusive(struct pseudo_list **list, pseudo_t pseudo)
+static void *alloc_array(unsigned int nr, size_t size)
 {
-	if (!pseudo_in_list(*list, pseudo)) {
-		liveness_changed = 1;
-		add_pseudo(list, pseudo);
-	}
+	void *array = calloc(nr + 1, size);
+
+	if (!array)
+		die("out of memory for the liveness");
+	return array;
 }
 
 static inline int trackable_pseudo(pseudo_t pseudo)
@@ -153,33 +187,120 @@ static inline int trackable_pseudo(pseudo_t pseudo)
 	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
 }
 
+static unsigned int pseudo_index(pseudo_t pseudo)
+{
+	unsigned long nr = (unsigned long) pseudo->priv;
+
+	if (nr)
+		return nr - 1;
+	if (live_nr == live_max)
+		live_pseudos = grow_array(live_pseudos, &live_max, sizeof(*live_pseudos));
+	live_pseudos[live_nr++] = pseudo;
+	pseudo->priv = (void *) (unsigned long) live_nr;
+	return live_nr - 1;
+}
+
+static inline unsigned int bb_index(struct basic_block *bb)
+{
+	return (unsigned long) bb->priv;
+}
+
+static void number_pseudo(struct basic_block *bb, pseudo_t pseudo)
+{
+	if (trackable_pseudo(pseudo))
+		pseudo_index(pseudo);
+}
+
+static void number_none(struct basic_block *bb, pseudo_t pseudo)
+{
+}
+
+//
+// Only the pseudos used outside of the BB defining them can be
+// live-in somewhere: they are the only ones needing a number for
+// the liveness itself.
+//
+static inline int global_use(struct basic_block *bb, pseudo_t pseudo)
+{
+	struct instruction *def = pseudo->def;
+
+	return pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI;
+}
+
+static void number_global(struct basic_block *bb, pseudo_t pseudo)
+{
+	if (trackable_pseudo(pseudo) && global_use(bb, pseudo))
+		pseudo_index(pseudo);
+}
+
+static void scan_usage(struct entrypoint *ep,
+	void (*def)(struct basic_block *, pseudo_t),
+	void (*use)(struct basic_block *, pseudo_t))
+{
+	struct basic_block *bb;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
+			assert(insn->bb == bb);
+			track_instruction_usage(bb, insn, def, use);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+}
+
+static void release_numbering(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < live_nr; i++)
+		live_pseudos[i]->priv = NULL;
+	live_nr = 0;
+}
+
 static void insn_uses(struct basic_block *bb, pseudo_t pseudo)
 {
-	if (trackable_pseudo(pseudo)) {
-		struct instruction *def = pseudo->def;
-		if (pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI)
-			add_pseudo_exclusive(&bb->needs, pseudo);
+	if (trackable_pseudo(pseudo) && global_use(bb, pseudo)) {
+		if (uses_nr == uses_max)
+			live_uses = grow_array(live_uses, &uses_max, sizeof(*live_uses));
+		live_uses[uses_nr].pseudo = pseudo_index(pseudo);
+		live_uses[uses_nr++].bb = bb_index(bb);
 	}
 }
 
 static void insn_defines(struct basic_block *bb, pseudo_t pseudo)
 {
 	assert(trackable_pseudo(pseudo));
-	add_pseudo(&bb->defines, pseudo);
+	if (!pseudo->priv)		// never live-in, so never live-out
+		return;
+	if (defs_nr == defs_max)
+		live_defs = grow_array(live_defs, &defs_max, sizeof(*live_defs));
+	live_defs[defs_nr].pseudo = pseudo_index(pseudo);
+	live_defs[defs_nr++].bb = bb_index(bb);
 }
 
-static void track_bb_liveness(struct basic_block *bb)
+//
+// Group the BBs of the references by pseudo: the BBs referencing
+// the pseudo N are then in bbs[first[N]] ... bbs[first[N+1] - 1].
+//
+static unsigned int *group_refs(struct live_ref *refs, unsigned int nr, unsigned int **pbbs)
 {
-	pseudo_t needs;
-
-	FOR_EACH_PTR(bb->needs, needs) {
-		struct basic_block *parent;
-		FOR_EACH_PTR(bb->parents, parent) {
-			if (!pseudo_in_list(parent->defines, needs)) {
-				add_pseudo_exclusive(&parent->needs, needs);
-			}
-		} END_FOR_EACH_PTR(parent);
-	} END_FOR_EACH_PTR(needs);
+	unsigned int *first = alloc_array(live_nr + 1, sizeof(*first));
+	unsigned int *bbs = alloc_array(nr, sizeof(*bbs));
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		first[refs[i].pseudo + 1]++;
+	for (i = 0; i < live_nr; i++)
+		first[i + 1] += first[i];
+	for (i = 0; i < nr; i++)
+		bbs[first[refs[i].pseudo]++] = refs[i].bb;
+	memmove(first + 1, first, live_nr * sizeof(*first));
+	first[0] = 0;
+
+	*pbbs = bbs;
+	return first;
 }
 
 /*
@@ -202,50 +323,86 @@ void clear_liveness(struct entrypoint *ep)
  */
 void track_pseudo_liveness(struct entrypoint *ep)
 {
-	struct basic_block *bb;
+	unsigned long *needed, *defined, *kept;
+	unsigned int *use_first, *use_bbs;
+	unsigned int *def_first, *def_bbs;
+	struct basic_block **bbs, *bb;
+	unsigned int *work;
+	unsigned int nr = 0;
+	unsigned int p, i;
 
-	/* Add all the bb pseudo usage */
 	FOR_EACH_PTR(ep->bbs, bb) {
-		struct instruction *insn;
-		FOR_EACH_PTR(bb->insns, insn) {
-			if (!insn->bb)
-				continue;
-			assert(insn->bb == bb);
-			track_instruction_usage(bb, insn, insn_defines, insn_uses);
-		} END_FOR_EACH_PTR(insn);
+		nr++;
 	} END_FOR_EACH_PTR(bb);
-
-	/* Calculate liveness.. */
-	do {
-		liveness_changed = 0;
-		FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
-			track_bb_liveness(bb);
-		} END_FOR_EACH_PTR_REVERSE(bb);
-	} while (liveness_changed);
-
-	/* Remove the pseudos from the "defines" list that are used internally */
+	bbs = alloc_array(nr, sizeof(*bbs));
+	nr = 0;
 	FOR_EACH_PTR(ep->bbs, bb) {
-		pseudo_t def;
-		FOR_EACH_PTR(bb->defines, def) {
-			struct basic_block *child;
-			FOR_EACH_PTR(bb->children, child) {
-				if (pseudo_in_list(child->needs, def))
-					goto is_used;
-			} END_FOR_EACH_PTR(child);
-			DELETE_CURRENT_PTR(def);
-is_used:
-		;
-		} END_FOR_EACH_PTR(def);
-		PACK_PTR_LIST(&bb->defines);
+		bb->priv = (void *) (unsigned long) nr;
+		bbs[nr++] = bb;
 	} END_FOR_EACH_PTR(bb);
-}
 
-static void merge_pseudo_list(struct pseudo_list *src, struct pseudo_list **dest)
-{
-	pseudo_t pseudo;
-	FOR_EACH_PTR(src, pseudo) {
-		add_pseudo_exclusive(dest, pseudo);
-	} END_FOR_EACH_PTR(pseudo);
+	/* Add all the bb pseudo usage */
+	scan_usage(ep, number_none, number_global);
+	scan_usage(ep, insn_defines, insn_uses);
+	use_first = group_refs(live_uses, uses_nr, &use_bbs);
+	def_first = group_refs(live_defs, defs_nr, &def_bbs);
+
+	/* Calculate liveness.. */
+	needed = alloc_array(LONGS(nr), sizeof(*needed));
+	defined = alloc_array(LONGS(nr), sizeof(*defined));
+	kept = alloc_array(LONGS(nr), sizeof(*kept));
+	work = alloc_array(nr, sizeof(*work));
+	for (p = 0; p < live_nr; p++) {
+		pseudo_t pseudo = live_pseudos[p];
+		unsigned int top = 0;
+
+		for (i = def_first[p]; i < def_first[p + 1]; i++)
+			set_bit(def_bbs[i], defined);
+		for (i = use_first[p]; i < use_first[p + 1]; i++) {
+			unsigned int n = use_bbs[i];
+			if (test_and_set_bit(n, needed))
+				continue;
+			add_pseudo(&bbs[n]->needs, pseudo);
+			work[top++] = n;
+		}
+
+		for (i = 0; i < top; i++) {
+			struct basic_block *parent;
+			FOR_EACH_PTR(bbs[work[i]]->parents, parent) {
+				unsigned int n = bb_index(parent);
+
+				if (test_bit(n, defined)) {
+					/* Only keep the defines used by a child */
+					if (!test_and_set_bit(n, kept))
+						add_pseudo(&parent->defines, pseudo);
+				} else if (!test_and_set_bit(n, needed)) {
+					add_pseudo(&parent->needs, pseudo);
+					work[top++] = n;
+				}
+			} END_FOR_EACH_PTR(parent);
+		}
+
+		for (i = 0; i < top; i++)
+			clear_bit(work[i], needed);
+		for (i = def_first[p]; i < def_first[p + 1]; i++) {
+			clear_bit(def_bbs[i], defined);
+			clear_bit(def_bbs[i], kept);
+		}
+	}
+
+	for (i = 0; i < nr; i++)
+		bbs[i]->priv = NULL;
+	release_numbering();
+	uses_nr = defs_nr = 0;
+	free(work);
+	free(kept);
+	free(defined);
+	free(needed);
+	free(def_bbs);
+	free(def_first);
+	free(use_bbs);
+	free(use_first);
+	free(bbs);
 }
 
 static void track_phi_uses(struct instruction *insn)
@@ -269,7 +426,8 @@ static void track_bb_phi_uses(struct basic_block *bb)
 	} END_FOR_EACH_PTR(insn);
 }
 
-static struct pseudo_list **live_list;
+static unsigned long *live_bits;
+static unsigned int live_words;
 static struct pseudo_list *dead_list;
 
 static void death_def(struct basic_block *bb, pseudo_t pseudo)
@@ -278,23 +436,23 @@ static void death_def(struct basic_block *bb, pseudo_t pseudo)
 
 static void death_use(struct basic_block *bb, pseudo_t pseudo)
 {
-	if (trackable_pseudo(pseudo) && !pseudo_in_list(*live_list, pseudo)) {
+	if (trackable_pseudo(pseudo) && !test_and_set_bit(pseudo_index(pseudo), live_bits))
 		add_pseudo(&dead_list, pseudo);
-		add_pseudo(live_list, pseudo);
-	}
 }
 
 static void track_pseudo_death_bb(struct basic_block *bb)
 {
-	struct pseudo_list *live = NULL;
 	struct basic_block *child;
 	struct instruction *insn;
 
+	memset(live_bits, 0, live_words * sizeof(*live_bits));
 	FOR_EACH_PTR(bb->children, child) {
-		merge_pseudo_list(child->needs, &live);
+		pseudo_t needs;
+		FOR_EACH_PTR(child->needs, needs) {
+			set_bit(pseudo_index(needs), live_bits);
+		} END_FOR_EACH_PTR(needs);
 	} END_FOR_EACH_PTR(child);
 
-	live_list = &live;
 	FOR_EACH_PTR_REVERSE(bb->insns, insn) {
 		if (!insn->bb)
 			continue;
@@ -313,7 +471,6 @@ static void track_pseudo_death_bb(struct basic_block *bb)
 			free_ptr_list(&dead_list);
 		}
 	} END_FOR_EACH_PTR_REVERSE(insn);
-	free_ptr_list(&live);
 }
 
 void track_pseudo_death(struct entrypoint *ep)
@@ -324,7 +481,13 @@ void track_pseudo_death(struct entrypoint *ep)
 		track_bb_phi_uses(bb);
 	} END_FOR_EACH_PTR(bb);
 
+	scan_usage(ep, number_pseudo, number_pseudo);
+	live_words = LONGS(live_nr);
+	live_bits = alloc_array(live_words, sizeof(*live_bits));
 	FOR_EACH_PTR(ep->bbs, bb) {
 		track_pseudo_death_bb(bb);
 	} END_FOR_EACH_PTR(bb);
+	free(live_bits);
+	live_bits = NULL;
+	release_numbering();
 }
@@ -16,6 +16,583 @@
 #include "linearize.h"
 #include "simplify.h"
 #include "flow.h"
+#include "target.h"
+#include "allocate.h"
+#include "summary.h"
+
+/*
+ * Index of the memory accesses.
+ *
+ * Finding what dominates a load or a store is done by walking
+ * backward over the preceding instructions of the BB (and then of
+ * its parents) until one of them is found to dominate or to maybe
+ * alias it. Most of the time this stops quickly but it's quadratic
+ * on big BBs with many accesses which don't interfere, typically
+ * to a local array or structure.
+ *
+ * So, the walk only looks at a limited number of accesses. When
+ * this is not enough, and it happened often enough in this BB to
+ * pay for it, the accesses of the BB are put on some chains, one
+ * per kind of access, for example all the memops to the same
+ * address, offset and size, and the ones which can dominate are
+ * then simply the latest entries, before the position of the load
+ * or store, of a few chains.
+ *
+ * The chains are not updated when instructions are killed or
+ * converted: each entry is checked when found and the invalid ones
+ * are skipped. The only exception are the accesses which get a new
+ * address when the load computing it is replaced: these are added
+ * to a separate, unordered, chain of their BB and checked with
+ * dominates() by each query.
+ */
+enum chain_kind {
+	CHAIN_BB,		// all the accesses of a BB
+	CHAIN_ADDR,		// aliasing memops of a BB for a given address
+	CHAIN_OFFSET,		// idem for a given address & offset
+	CHAIN_EXACT,		// all memops of a BB for a given address, offset & size
+	CHAIN_PSEUDO,		// all indexed memops for a given address
+};
+
+struct memop_entry {
+	struct instruction *insn;
+	pseudo_t addr;			// the address when indexed, if a memop
+	unsigned int opcode;		// the opcode when indexed
+	unsigned int pos;		// position in the BB, starting at 1
+	struct memop_entry *prev, *next;
+	struct memop_entry *prev_other;	// nearest entries with another address
+	struct memop_entry *next_other;	// (only used for the 'alias' chain)
+};
+
+struct memop_chain {
+	struct memop_chain *hash_next;
+	struct memop_chain *all_next;	// list of all the hashed chains
+	enum chain_kind kind;
+	struct basic_block *bb;
+	pseudo_t addr;
+	long long offset;
+	unsigned int size;
+	struct memop_entry *first, *last;
+	struct memop_entry *cursor;	// where the last query ended
+	union {
+		struct /* CHAIN_BB */ {
+			struct memop_chain *calls;	// calls which may write & entry
+			struct memop_chain *reads;	// calls which may read & entry
+			struct memop_chain *asms;	// asms clobbering memory
+			struct memop_chain *alias;	// aliasing memops
+			struct memop_chain *nonsym;	// idem, not via a symbol
+			struct memop_chain *moved;	// memops with a new address
+			bool indexed;			// are the chains made?
+			unsigned int walks;		// in units of SCAN_LIMIT accesses
+			unsigned int nr_insns;
+		};
+		struct /* CHAIN_ADDR */ {
+			struct memop_chain *offsets;
+			unsigned int nr_offsets;
+			unsigned int max_size;
+		};
+		struct /* CHAIN_OFFSET */ {
+			struct memop_chain *next_offset;
+		};
+		struct /* CHAIN_PSEUDO */ {
+			int local;			// cached local_pseudo()
+		};
+	};
+};
+
+DECLARE_ALLOCATOR(memop_entry);
+ALLOCATOR(memop_entry, "memop entries");
+DECLARE_ALLOCATOR(memop_chain);
+ALLOCATOR(memop_chain, "memop chains");
+
+#define CHAIN_HASH_BITS	10
+#define POS_END		(~0U)
+
+// number of accesses walked over between two checks for using the chains
+#define SCAN_LIMIT	32
+
+// rough cost of indexing an instruction, relative to walking over it
+#define INDEX_COST	8
+
+// max number of offsets looked at for overlapping accesses
+#define OVERLAP_WINDOW	32
+
+static struct memop_chain **chain_hash;
+static unsigned int chain_hash_bits;
+static unsigned int nr_chains;
+static struct memop_chain *all_chains;
+
+// are the loads put in the aliasing chains?
+static bool index_loads;
+
+// SCAN_LIMIT or, with -vmemops-index, 1 to index all the BBs at once
+static unsigned int scan_limit;
+
+static unsigned int chain_hashval(enum chain_kind kind, struct basic_block *bb,
+	pseudo_t addr, long long offset, unsigned int size)
+{
+	unsigned long long hash;
+
+	hash = (unsigned long) bb * 0x9e3779b97f4a7c15ULL;
+	hash ^= (unsigned long) addr * 0xc2b2ae3d27d4eb4fULL;
+	hash ^= (offset << 8) ^ ((unsigned long long)size << 40) ^ kind;
+	hash ^= hash >> 29;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	return hash ^ (hash >> 32);
+}
+
+static void resize_chain_hash(unsigned int bits)
+{
+	unsigned int i, size = 1U << bits;
+	unsigned int old_size = chain_hash ? 1U << chain_hash_bits : 0;
+	struct memop_chain **table = calloc(size, sizeof(*table));
+
+	if (!table)
+		die("out of memory");
+	for (i = 0; i < old_size; i++) {
+		struct memop_chain *c = chain_hash[i];
+
+		while (c) {
+			struct memop_chain *next = c->hash_next;
+			unsigned int h = chain_hashval(c->kind, c->bb, c->addr, c->offset, c->size);
+			struct memop_chain **p = &table[h & (size - 1)];
+
+			c->hash_next = *p;
+			*p = c;
+			c = next;
+		}
+	}
+	free(chain_hash);
+	chain_hash = table;
+	chain_hash_bits = bits;
+}
+
+static struct memop_chain *lookup_chain(enum chain_kind kind, struct basic_block *bb,
+	pseudo_t addr, long long offset, unsigned int size, bool create)
+{
+	unsigned int h = chain_hashval(kind, bb, addr, offset, size);
+	struct memop_chain **p, *c;
+
+	if (!chain_hash)
+		resize_chain_hash(CHAIN_HASH_BITS);
+	p = &chain_hash[h & ((1U << chain_hash_bits) - 1)];
+	for (c = *p; c; c = c->hash_next) {
+		if (c->kind == kind && c->bb == bb && c->addr == addr &&
+		    c->offset == offset && c->size == size)
+			return c;
+	}
+	if (!create)
+		return NULL;
+
+	if (nr_chains >= (1U << chain_hash_bits)) {
+		resize_chain_hash(chain_hash_bits + 1);
+		p = &chain_hash[h & ((1U << chain_hash_bits) - 1)];
+	}
+	nr_chains++;
+	c = __alloc_memop_chain(0);
+	c->kind = kind;
+	c->bb = bb;
+	c->addr = addr;
+	c->offset = offset;
+	c->size = size;
+	c->hash_next = *p;
+	*p = c;
+	c->all_next = all_chains;
+	all_chains = c;
+	if (kind == CHAIN_PSEUDO)
+		c->local = -1;
+	return c;
+}
+
+static inline struct memop_chain *find_chain(enum chain_kind kind, struct basic_block *bb,
+	pseudo_t addr, long long offset, unsigned int size)
+{
+	if (!nr_chains)
+		return NULL;
+	return lookup_chain(kind, bb, addr, offset, size, false);
+}
+
+// get one of the chains of a BB, these are not hashed
+static inline struct memop_chain *bb_chain(struct memop_chain **chain)
+{
+	if (!*chain)
+		*chain = __alloc_memop_chain(0);
+	return *chain;
+}
+
+static void add_entry(struct memop_chain *c, struct instruction *insn,
+	pseudo_t addr, unsigned int pos)
+{
+	struct memop_entry *e = __alloc_memop_entry(0);
+	struct memop_entry *last = c->last;
+
+	e->insn = insn;
+	e->addr = addr;
+	e->opcode = insn->opcode;
+	e->pos = pos;
+	e->prev = last;
+	if (last) {
+		last->next = e;
+		if (last->addr != addr) {
+			struct memop_entry *x;
+
+			e->prev_other = last;
+			for (x = last; x && x->addr == last->addr && !x->next_other; x = x->prev)
+				x->next_other = e;
+		} else {
+			e->prev_other = last->prev_other;
+		}
+	} else {
+		c->first = e;
+	}
+	c->last = e;
+	c->cursor = e;
+}
+
+///
+// forget everything indexed so far
+// @loads: if the loads must be put in the aliasing chains from now on
+static void reset_index(bool loads)
+{
+	unsigned int mask = (1U << chain_hash_bits) - 1;
+	struct memop_chain *c;
+
+	index_loads = loads;
+	if (!nr_chains)
+		return;
+
+	// the table can be big, only clear the used buckets
+	for (c = all_chains; c; c = c->all_next)
+		chain_hash[chain_hashval(c->kind, c->bb, c->addr, c->offset, c->size) & mask] = NULL;
+	all_chains = NULL;
+	nr_chains = 0;
+	clear_memop_entry_alloc();
+	clear_memop_chain_alloc();
+}
+
+static inline bool entry_valid(struct memop_entry *e)
+{
+	struct instruction *insn = e->insn;
+
+	if (!insn->bb || insn->opcode != e->opcode)
+		return false;
+	return !e->addr || insn->src == e->addr;
+}
+
+static inline bool is_access(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_ASM:
+		return insn->clobber_memory || insn->output_memory;
+	case OP_CALL:
+		return call_reads_memory(insn) || call_writes_memory(insn);
+	case OP_ENTRY:
+	case OP_LOAD: case OP_STORE:
+		return true;
+	}
+	return false;
+}
+
+///
+// number the accesses of a BB and put them on their chains
+static struct memop_chain *index_accesses(struct basic_block *bb)
+{
+	struct memop_chain *blk = lookup_chain(CHAIN_BB, bb, NULL, 0, 0, true);
+	struct instruction *insn;
+	unsigned int pos = 0;
+
+	if (blk->indexed)
+		return blk;
+	blk->indexed = true;
+	FOR_EACH_PTR(bb->insns, insn) {
+		struct memop_chain *c;
+		pseudo_t addr;
+
+		if (!insn->bb || !is_access(insn))
+			continue;
+		add_entry(blk, insn, NULL, ++pos);
+		switch (insn->opcode) {
+		case OP_CALL: case OP_ENTRY:
+			if (insn->opcode == OP_ENTRY || call_writes_memory(insn))
+				add_entry(bb_chain(&blk->calls), insn, NULL, pos);
+			if (insn->opcode == OP_ENTRY || call_reads_memory(insn))
+				add_entry(bb_chain(&blk->reads), insn, NULL, pos);
+			continue;
+		case OP_ASM:
+			add_entry(bb_chain(&blk->asms), insn, NULL, pos);
+			continue;
+		}
+
+		addr = insn->src;
+		c = lookup_chain(CHAIN_EXACT, bb, addr, insn->offset, insn->size, true);
+		add_entry(c, insn, addr, pos);
+		c = lookup_chain(CHAIN_PSEUDO, NULL, addr, 0, 0, true);
+		add_entry(c, insn, addr, pos);
+		if (insn->opcode == OP_LOAD && !index_loads)
+			continue;
+
+		add_entry(bb_chain(&blk->alias), insn, addr, pos);
+		if (addr->type != PSEUDO_SYM)
+			add_entry(bb_chain(&blk->nonsym), insn, addr, pos);
+		c = lookup_chain(CHAIN_ADDR, bb, addr, 0, 0, true);
+		add_entry(c, insn, addr, pos);
+		if (insn->size > c->max_size)
+			c->max_size = insn->size;
+		c = lookup_chain(CHAIN_OFFSET, bb, addr, insn->offset, 0, true);
+		if (!c->first) {
+			struct memop_chain *ac = find_chain(CHAIN_ADDR, bb, addr, 0, 0);
+
+			c->next_offset = ac->offsets;
+			ac->offsets = c;
+			ac->nr_offsets++;
+		}
+		add_entry(c, insn, addr, pos);
+	} END_FOR_EACH_PTR(insn);
+	return blk;
+}
+
+static inline struct memop_entry *later(struct memop_entry *a, struct memop_entry *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	return a->pos > b->pos ? a : b;
+}
+
+static inline struct memop_entry *earlier(struct memop_entry *a, struct memop_entry *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	return a->pos < b->pos ? a : b;
+}
+
+///
+// find the latest valid entry of a chain before a position
+// @limit: the position, POS_END for the whole BB
+//
+// The queries inside a BB are mostly done for decreasing positions,
+// so the search starts where the previous one ended.
+static struct memop_entry *chain_latest(struct memop_chain *c, unsigned int limit)
+{
+	struct memop_entry *e;
+
+	if (!c)
+		return NULL;
+	if (limit == POS_END) {
+		while ((e = c->last) && !entry_valid(e))
+			c->last = e->prev;
+		return e;
+	}
+
+	e = c->cursor ? c->cursor : c->first;
+	while (e && e->next && e->next->pos < limit)
+		e = e->next;
+	while (e && (e->pos >= limit || !entry_valid(e)))
+		e = e->prev;
+	c->cursor = e;
+	return e;
+}
+
+// same as chain_latest() but for an address different than 'addr'
+static struct memop_entry *chain_latest_other(struct memop_chain *c, unsigned int limit, pseudo_t addr)
+{
+	struct memop_entry *e = chain_latest(c, limit);
+
+	while (e) {
+		if (!entry_valid(e))
+			e = e->prev;
+		else if (e->addr != addr)
+			break;
+		else
+			e = e->prev_other;
+	}
+	return e;
+}
+
+///
+// find the earliest valid entry of a chain after a position
+static struct memop_entry *chain_earliest(struct memop_chain *c, unsigned int after)
+{
+	struct memop_entry *e;
+
+	if (!c)
+		return NULL;
+	while ((e = c->first) && !entry_valid(e))
+		c->first = e->next;
+	while (e && (e->pos <= after || !entry_valid(e)))
+		e = e->next;
+	return e;
+}
+
+static struct memop_entry *chain_earliest_other(struct memop_chain *c, unsigned int after, pseudo_t addr)
+{
+	struct memop_entry *e = chain_earliest(c, after);
+
+	while (e) {
+		if (!entry_valid(e))
+			e = e->next;
+		else if (e->addr != addr)
+			break;
+		else
+			e = e->next_other;
+	}
+	return e;
+}
+
+static bool overlapping_entry(struct instruction *insn, struct memop_entry *e, bool exact)
+{
+	struct instruction *dom = e->insn;
+
+	if (!entry_valid(e))
+		return false;
+	if (!overlapping_memop(insn, dom))
+		return false;
+	return exact || dom->offset != insn->offset || dom->size != insn->size;
+}
+
+static struct memop_entry *latest_in_chain(struct instruction *insn, struct memop_chain *c,
+	unsigned int limit, struct memop_entry *best, bool exact)
+{
+	struct memop_entry *e;
+
+	for (e = chain_latest(c, limit); e; e = e->prev) {
+		if (best && e->pos <= best->pos)
+			break;
+		if (overlapping_entry(insn, e, exact))
+			return e;
+	}
+	return best;
+}
+
+static struct memop_entry *earliest_in_chain(struct instruction *insn, struct memop_chain *c,
+	unsigned int after, struct memop_entry *best)
+{
+	struct memop_entry *e;
+
+	for (e = chain_earliest(c, after); e; e = e->next) {
+		if (best && e->pos >= best->pos)
+			break;
+		if (overlapping_entry(insn, e, false))
+			return e;
+	}
+	return best;
+}
+
+///
+// find the latest indexed access to the same address which overlaps 'insn'
+// @exact: also return the accesses at the same offset and with the same size
+// @best: an already found entry, only later ones are of interest
+//
+// Only the offsets which can overlap are looked at, unless there
+// are too many of them and then all the accesses are checked.
+static struct memop_entry *latest_overlap(struct instruction *insn, struct basic_block *bb,
+	unsigned int limit, struct memop_entry *best, bool exact)
+{
+	struct memop_chain *ac = find_chain(CHAIN_ADDR, bb, insn->src, 0, 0);
+	struct memop_chain *c;
+	long long lo, hi;
+
+	if (!ac)
+		return best;
+	lo = insn->offset - bits_to_bytes(ac->max_size);
+	hi = insn->offset + bits_to_bytes(insn->size);
+	if (ac->nr_offsets <= hi - lo + 1) {
+		for (c = ac->offsets; c; c = c->next_offset) {
+			if (c->offset >= lo && c->offset <= hi)
+				best = latest_in_chain(insn, c, limit, best, exact);
+		}
+	} else if (hi - lo < OVERLAP_WINDOW) {
+		for (; lo <= hi; lo++) {
+			c = find_chain(CHAIN_OFFSET, bb, insn->src, lo, 0);
+			best = latest_in_chain(insn, c, limit, best, exact);
+		}
+	} else {
+		best = latest_in_chain(insn, ac, limit, best, exact);
+	}
+	return best;
+}
+
+// same as latest_overlap() but for the earliest non-exact access after a position
+static struct memop_entry *earliest_overlap(struct instruction *insn, struct basic_block *bb,
+	unsigned int after, struct memop_entry *best)
+{
+	struct memop_chain *ac = find_chain(CHAIN_ADDR, bb, insn->src, 0, 0);
+	struct memop_chain *c;
+	long long lo, hi;
+
+	if (!ac)
+		return best;
+	lo = insn->offset - bits_to_bytes(ac->max_size);
+	hi = insn->offset + bits_to_bytes(insn->size);
+	if (ac->nr_offsets <= hi - lo + 1) {
+		for (c = ac->offsets; c; c = c->next_offset) {
+			if (c->offset >= lo && c->offset <= hi)
+				best = earliest_in_chain(insn, c, after, best);
+		}
+	} else if (hi - lo < OVERLAP_WINDOW) {
+		for (; lo <= hi; lo++) {
+			c = find_chain(CHAIN_OFFSET, bb, insn->src, lo, 0);
+			best = earliest_in_chain(insn, c, after, best);
+		}
+	} else {
+		best = earliest_in_chain(insn, ac, after, best);
+	}
+	return best;
+}
+
+///
+// check the accesses whose address has changed since the indexing
+static struct memop_entry *latest_moved(struct instruction *insn, struct memop_chain *c,
+	unsigned int limit, struct memop_entry *best, int local)
+{
+	struct memop_entry *e;
+
+	for (e = c ? c->first : NULL; e; e = e->next) {
+		int dominance;
+
+		if (e->pos >= limit || (best && e->pos <= best->pos))
+			continue;
+		if (!entry_valid(e))
+			continue;
+		dominance = dominates(insn, e->insn, local);
+		if (!dominance)
+			continue;
+		if (dominance < 0 && e->opcode == OP_LOAD)
+			continue;
+		best = e;
+	}
+	return best;
+}
+
+///
+// update the index for the memops using 'addr' which now use another address
+static void moved_memops(pseudo_t addr)
+{
+	struct memop_chain *c = find_chain(CHAIN_PSEUDO, NULL, addr, 0, 0);
+	struct memop_entry *e;
+
+	for (e = c ? c->first : NULL; e; e = e->next) {
+		struct instruction *insn = e->insn;
+		struct memop_chain *blk;
+
+		if (!insn->bb || insn->opcode != e->opcode || insn->src == addr)
+			continue;
+		blk = find_chain(CHAIN_BB, insn->bb, NULL, 0, 0);
+		add_entry(bb_chain(&blk->moved), insn, insn->src, e->pos);
+		c = lookup_chain(CHAIN_PSEUDO, NULL, insn->src, 0, 0, true);
+		add_entry(c, insn, insn->src, e->pos);
+	}
+}
+
+static void replace_load(struct instruction *insn, pseudo_t new)
+{
+	pseudo_t target = insn->target;
+
+	replace_with_pseudo(insn, new);
+	moved_memops(target);
+}
 
 static void rewrite_load_instruction(struct instruction *insn, struct pseudo_list *dominators)
 {
@@ -38,7 +615,7 @@ static void rewrite_load_instruction(struct instruction *insn, struct pseudo_lis
 	 * and convert the load into a LNOP and replace the
 	 * pseudo.
 	 */
-	replace_with_pseudo(insn, new);
+	replace_load(insn, new);
 	FOR_EACH_PTR(dominators, phi) {
 		kill_instruction(phi->def);
 	} END_FOR_EACH_PTR(phi);
@@ -53,6 +630,148 @@ end:
 	repeat_phase |= REPEAT_CSE;
 }
 
+static int address_taken(pseudo_t pseudo)
+{
+	struct pseudo_user *pu;
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+		// a function not accessing memory can only keep the address
+		if (insn->bb && insn->opcode == OP_CALL && !call_reads_memory(insn)
+		    && !call_writes_memory(insn) && !call_operand_escapes(insn, pu->userp))
+			continue;
+		if (insn->bb && (insn->opcode != OP_LOAD && insn->opcode != OP_STORE))
+			return 1;
+		if (pu->userp != &insn->src)
+			return 1;
+	} END_FOR_EACH_PTR(pu);
+	return 0;
+}
+
+static int local_pseudo(pseudo_t pseudo)
+{
+	return pseudo->type == PSEUDO_SYM
+		&& !(pseudo->sym->ctype.modifiers & (MOD_STATIC | MOD_NONLOCAL))
+		&& !address_taken(pseudo);
+}
+
+// same as local_pseudo() but cached for the indexed addresses,
+// address_taken() can be slow
+static int memop_local(pseudo_t pseudo)
+{
+	struct memop_chain *c = find_chain(CHAIN_PSEUDO, NULL, pseudo, 0, 0);
+
+	if (!c)
+		return local_pseudo(pseudo);
+	if (c->local < 0)
+		c->local = local_pseudo(pseudo);
+	return c->local;
+}
+
+static bool compatible_loads(struct instruction *a, struct instruction *b)
+{
+	if (is_integral_type(a->type) && is_float_type(b->type))
+		return false;
+	if (is_float_type(a->type) && is_integral_type(b->type))
+		return false;
+	return true;
+}
+
+///
+// decide if a BB must be indexed, once SCAN_LIMIT more of its
+// accesses were walked over.
+//
+// Indexing a BB costs much more than walking over it, so it's only
+// done once the walks made in it would have paid for it.
+static bool use_index(struct basic_block *bb)
+{
+	struct memop_chain *blk = lookup_chain(CHAIN_BB, bb, NULL, 0, 0, true);
+
+	if (blk->indexed || dbg_memops_index)
+		return true;
+	if (!blk->nr_insns)
+		blk->nr_insns = instruction_list_size(bb->insns);
+	return ++blk->walks * SCAN_LIMIT > INDEX_COST * blk->nr_insns;
+}
+
+///
+// find the entry of an access of an indexed BB
+// @cursor: where to start the search, backward, updated with the result.
+static struct memop_entry *find_entry(struct memop_chain *blk,
+	struct instruction *insn, struct memop_entry **cursor)
+{
+	struct memop_entry *e = *cursor ? *cursor : blk->last;
+
+	while (e->insn != insn)
+		e = e->prev;
+	return *cursor = e;
+}
+
+///
+// find the latest access in the BB, before a position, which can dominate a load
+// @limit: the position, POS_END for the whole BB
+// @return: the instruction found or NULL if there isn't any.
+//
+// The result is the first instruction, walking backward, for which
+// dominates() is positive, or negative but not a load.
+static struct instruction *load_dominator(struct instruction *insn, struct memop_chain *blk,
+	unsigned int limit, int local)
+{
+	struct basic_block *bb = blk->bb;
+	pseudo_t addr = insn->src;
+	struct memop_entry *best;
+
+	best = chain_latest(blk->asms, limit);
+	if (!local) {
+		best = later(best, chain_latest(blk->calls, limit));
+		if (addr->type == PSEUDO_SYM)
+			best = later(best, chain_latest(blk->nonsym, limit));
+		else
+			best = later(best, chain_latest_other(blk->alias, limit, addr));
+	}
+	best = later(best, chain_latest(find_chain(CHAIN_EXACT, bb, addr, insn->offset, insn->size), limit));
+	best = latest_overlap(insn, bb, limit, best, true);
+	best = latest_moved(insn, blk->moved, limit, best, local);
+	return best ? best->insn : NULL;
+}
+
+///
+// find the latest access in the BB, before a position, which prevents
+// to kill a store, other than the ones to the same address, offset and size.
+static struct memop_entry *store_barrier(struct instruction *insn, struct memop_chain *blk,
+	unsigned int limit, int local)
+{
+	pseudo_t addr = insn->src;
+	struct memop_entry *best;
+
+	best = chain_latest(blk->asms, limit);
+	if (!local) {
+		best = later(best, chain_latest(blk->reads, limit));
+		if (addr->type == PSEUDO_SYM)
+			best = later(best, chain_latest(blk->nonsym, limit));
+		else
+			best = later(best, chain_latest_other(blk->alias, limit, addr));
+	}
+	return latest_overlap(insn, blk->bb, limit, best, false);
+}
+
+// same as store_barrier() but for the earliest one after a position
+static struct memop_entry *store_barrier_after(struct instruction *insn, struct memop_chain *blk,
+	unsigned int after, int local)
+{
+	pseudo_t addr = insn->src;
+	struct memop_entry *best;
+
+	best = chain_earliest(blk->asms, after);
+	if (!local) {
+		best = earlier(best, chain_earliest(blk->reads, after));
+		if (addr->type == PSEUDO_SYM)
+			best = earlier(best, chain_earliest(blk->nonsym, after));
+		else
+			best = earlier(best, chain_earliest_other(blk->alias, after, addr));
+	}
+	return earliest_overlap(insn, blk->bb, after, best);
+}
+
 static int find_dominating_parents(struct instruction *insn,
 	struct basic_block *bb, struct pseudo_list **dominators,
 	int local)
@@ -63,6 +782,7 @@ static int find_dominating_parents(struct instruction *insn,
 		struct instruction *phisrc;
 		struct instruction *one;
 		pseudo_t phi;
+		int n = 0;
 
 		FOR_EACH_PTR_REVERSE(parent->insns, one) {
 			int dominance;
@@ -70,6 +790,14 @@ static int find_dominating_parents(struct instruction *insn,
 				continue;
 			if (one == insn)
 				goto no_dominance;
+			if (is_access(one) && ++n % scan_limit == 0 && use_index(parent)) {
+				one = load_dominator(insn, index_accesses(parent), POS_END, local);
+				if (!one || one == insn)
+					goto no_dominance;
+				if (dominates(insn, one, local) < 0)
+					return 0;
+				goto found_dominator;
+			}
 			dominance = dominates(insn, one, local);
 			if (dominance < 0) {
 				if (one->opcode == OP_LOAD)
@@ -98,39 +826,11 @@ found_dominator:
 		use_pseudo(insn, phi, add_pseudo(dominators, phi));
 	} END_FOR_EACH_PTR(parent);
 	return 1;
-}		
-
-static int address_taken(pseudo_t pseudo)
-{
-	struct pseudo_user *pu;
-	FOR_EACH_PTR(pseudo->users, pu) {
-		struct instruction *insn = pu->insn;
-		if (insn->bb && (insn->opcode != OP_LOAD && insn->opcode != OP_STORE))
-			return 1;
-		if (pu->userp != &insn->src)
-			return 1;
-	} END_FOR_EACH_PTR(pu);
-	return 0;
-}
-
-static int local_pseudo(pseudo_t pseudo)
-{
-	return pseudo->type == PSEUDO_SYM
-		&& !(pseudo->sym->ctype.modifiers & (MOD_STATIC | MOD_NONLOCAL))
-		&& !address_taken(pseudo);
-}
-
-static bool compatible_loads(struct instruction *a, struct instruction *b)
-{
-	if (is_integral_type(a->type) && is_float_type(b->type))
-		return false;
-	if (is_float_type(a->type) && is_integral_type(b->type))
-		return false;
-	return true;
 }
 
 static void simplify_loads(struct basic_block *bb)
 {
+	struct memop_entry *cursor = NULL;
 	struct instruction *insn;
 
 	FOR_EACH_PTR_REVERSE(bb->insns, insn) {
@@ -139,8 +839,9 @@ static void simplify_loads(struct basic_block *bb)
 		if (insn->opcode == OP_LOAD) {
 			struct instruction *dom;
 			pseudo_t pseudo = insn->src;
-			int local = local_pseudo(pseudo);
+			int local = memop_local(pseudo);
 			struct pseudo_list *dominators;
+			int n = 0;
 
 			if (insn->is_volatile)
 				continue;
@@ -154,6 +855,14 @@ static void simplify_loads(struct basic_block *bb)
 				int dominance;
 				if (!dom->bb)
 					continue;
+				if (is_access(dom) && ++n % scan_limit == 0 && use_index(bb)) {
+					struct memop_chain *blk = index_accesses(bb);
+					struct memop_entry *entry = find_entry(blk, insn, &cursor);
+
+					dom = load_dominator(insn, blk, entry->pos, local);
+					if (!dom)
+						goto parents;
+				}
 				dominance = dominates(insn, dom, local);
 				if (dominance) {
 					/* possible partial dominance? */
@@ -165,11 +874,12 @@ static void simplify_loads(struct basic_block *bb)
 					if (!compatible_loads(insn, dom))
 						goto next_load;
 					/* Yeehaa! Found one! */
-					replace_with_pseudo(insn, dom->target);
+					replace_load(insn, dom->target);
 					goto next_load;
 				}
 			} END_FOR_EACH_PTR_REVERSE(dom);
 
+parents:
 			/* OK, go find the parents */
 			bb->generation = ++bb_generation;
 			dominators = NULL;
@@ -178,7 +888,7 @@ static void simplify_loads(struct basic_block *bb)
 				if (!dominators) {
 					if (local) {
 						assert(pseudo->type != PSEUDO_ARG);
-						replace_with_pseudo(insn, value_pseudo(0));
+						replace_load(insn, value_pseudo(0));
 					}
 					goto next_load;
 				}
@@ -221,8 +931,57 @@ static bool try_to_kill_store(struct instruction *insn,
 	return true;
 }
 
+///
+// kill the stores of an indexed BB, before a position, made redundant by 'insn'
+// @return: false if something prevents to continue with the parents.
+static bool kill_stores_before(struct instruction *insn, struct memop_chain *blk,
+	unsigned int limit, int local)
+{
+	struct memop_entry *dom, *stop;
+
+	dom = chain_latest(find_chain(CHAIN_EXACT, blk->bb, insn->src, insn->offset, insn->size), limit);
+	stop = store_barrier(insn, blk, limit, local);
+	for (;;) {
+		for (; dom && (!stop || dom->pos > stop->pos); dom = dom->prev) {
+			if (!entry_valid(dom))
+				continue;
+			if (!try_to_kill_store(insn, dom->insn, local))
+				return false;
+		}
+		if (!stop)
+			return true;
+		if (entry_valid(stop))
+			return false;
+		// killed together with one of the stores, look further
+		stop = store_barrier(insn, blk, stop->pos, local);
+	}
+}
+
+// same as kill_stores_before() but walking forward from the start of the BB
+static void kill_stores_after(struct instruction *insn, struct memop_chain *blk, int local)
+{
+	struct memop_entry *dom, *stop;
+
+	dom = chain_earliest(find_chain(CHAIN_EXACT, blk->bb, insn->src, insn->offset, insn->size), 0);
+	stop = store_barrier_after(insn, blk, 0, local);
+	for (;;) {
+		for (; dom && (!stop || dom->pos < stop->pos); dom = dom->next) {
+			if (!entry_valid(dom))
+				continue;
+			if (dom->insn == insn)
+				return;
+			if (!try_to_kill_store(insn, dom->insn, local))
+				return;
+		}
+		if (!stop || entry_valid(stop))
+			return;
+		stop = store_barrier_after(insn, blk, stop->pos, local);
+	}
+}
+
 static void kill_dominated_stores(struct basic_block *bb)
 {
+	struct memop_entry *cursor = NULL;
 	struct instruction *insn;
 
 	FOR_EACH_PTR_REVERSE(bb->insns, insn) {
@@ -233,23 +992,33 @@ static void kill_dominated_stores(struct basic_block *bb)
 			struct instruction *dom;
 			pseudo_t pseudo = insn->src;
 			int local;
+			int n = 0;
 
 			if (!insn->type)
 				continue;
 			if (insn->is_volatile)
 				continue;
 
-			local = local_pseudo(pseudo);
+			local = memop_local(pseudo);
 			RECURSE_PTR_REVERSE(insn, dom) {
 				if (!dom->bb)
 					continue;
+				if (is_access(dom) && ++n % scan_limit == 0 && use_index(bb)) {
+					struct memop_chain *blk = index_accesses(bb);
+					struct memop_entry *entry = find_entry(blk, insn, &cursor);
+
+					if (!kill_stores_before(insn, blk, entry->pos, local))
+						goto next_store;
+					goto parents;
+				}
 				if (!try_to_kill_store(insn, dom, local))
 					goto next_store;
 			} END_FOR_EACH_PTR_REVERSE(dom);
 
+parents:
 			/* OK, we should check the parents now */
 			FOR_EACH_PTR(bb->parents, par) {
-
+				n = 0;
 				if (bb_list_size(par->children) != 1)
 					goto next_parent;
 				FOR_EACH_PTR(par->insns, dom) {
@@ -257,6 +1026,10 @@ static void kill_dominated_stores(struct basic_block *bb)
 						continue;
 					if (dom == insn)
 						goto next_parent;
+					if (is_access(dom) && ++n % scan_limit == 0 && use_index(par)) {
+						kill_stores_after(insn, index_accesses(par), local);
+						goto next_parent;
+					}
 					if (!try_to_kill_store(insn, dom, local))
 						goto next_parent;
 				} END_FOR_EACH_PTR(dom);
@@ -274,10 +1047,13 @@ void simplify_memops(struct entrypoint *ep)
 	struct basic_block *bb;
 	pseudo_t pseudo;
 
+	scan_limit = dbg_memops_index ? 1 : SCAN_LIMIT;
+	reset_index(false);
 	FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
 		simplify_loads(bb);
 	} END_FOR_EACH_PTR_REVERSE(bb);
 
+	reset_index(true);
 	FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
 		kill_dominated_stores(bb);
 	} END_FOR_EACH_PTR_REVERSE(bb);
@@ -292,4 +1068,5 @@ void simplify_memops(struct entrypoint *ep)
 			continue;
 		kill_dead_stores(ep, pseudo, local_pseudo(pseudo));
 	} END_FOR_EACH_PTR(pseudo);
+	reset_index(false);
 }
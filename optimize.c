@@ -14,7 +14,10 @@
 #include "liveness.h"
 #include "simplify.h"
 #include "flow.h"
+#include "inliner.h"
 #include "cse.h"
+#include "dce.h"
+#include "sccp.h"
 #include "ir.h"
 #include "ssa.h"
 
@@ -30,28 +33,135 @@ static void clear_symbol_pseudos(struct entrypoint *ep)
 }
 
 
-static void clean_up_insns(struct entrypoint *ep)
+///
+// Simplification worklist
+// ^^^^^^^^^^^^^^^^^^^^^^^
+// After an initial sweep over all the instructions, only the
+// instructions that may be simplified further are revisited:
+// the ones whose operands have changed (see use_pseudo() and
+// convert_instruction_target()), the neighbours of a changed
+// instruction and the remaining user of a pseudo that lost all
+// its other users.
+// The queued instructions are flagged, as well as their BB, and
+// are processed in the same order as a full sweep would do, since
+// the result of the simplifications depends somewhat on this order.
+bool worklist_active, worklist_pending;
+unsigned long simplify_visits;
+unsigned long optimized_insns;
+unsigned long optimized_calls;
+
+static void queue_direct_users(pseudo_t p)
 {
-	struct basic_block *bb;
+	struct pseudo_user *pu;
 
-	FOR_EACH_PTR(ep->bbs, bb) {
-		struct instruction *insn;
-		FOR_EACH_PTR(bb->insns, insn) {
-			if (!insn->bb)
-				continue;
-			repeat_phase |= simplify_instruction(insn);
-			if (!insn->bb)
+	FOR_EACH_PTR(p->users, pu) {
+		queue_instruction(pu->insn);
+	} END_FOR_EACH_PTR(pu);
+}
+
+///
+// queue the users of a pseudo and their own users, since many
+// simplifications look at the operands' operands.
+void queue_users(pseudo_t p)
+{
+	struct pseudo_user *pu;
+
+	if (!worklist_active || !has_use_list(p))
+		return;
+	FOR_EACH_PTR(p->users, pu) {
+		struct instruction *user = pu->insn;
+
+		queue_instruction(user);
+		if (user->bb && has_target(user))
+			queue_direct_users(user->target);
+	} END_FOR_EACH_PTR(pu);
+}
+
+static inline void queue_def(pseudo_t p)
+{
+	if (p->type == PSEUDO_REG)
+		queue_instruction(p->def);
+}
+
+///
+// some simplifications also modify in place the instructions
+// defining the operands, requeue them too.
+static void queue_operands(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_SEL:
+	case OP_RANGE:
+		queue_def(insn->src3);
+		/* fall through */
+	case OP_BINARY ... OP_BINCMP_END:
+		queue_def(insn->src2);
+		/* fall through */
+	case OP_UNOP ... OP_UNOP_END:
+	case OP_SLICE:
+	case OP_PHISOURCE:
+	case OP_CBR:
+	case OP_LOAD:
+	case OP_STORE:
+		queue_def(insn->src1);
+		break;
+	}
+}
+
+static int simplify_one(struct instruction *insn)
+{
+	int changed;
+
+	simplify_visits++;
+	changed = simplify_instruction(insn);
+	repeat_phase |= changed;
+	if (!changed || !insn->bb)
+		return changed;
+	queue_instruction(insn);
+	queue_operands(insn);
+	if (has_target(insn))
+		queue_users(insn->target);
+	return changed;
+}
+
+///
+// simplify the queued instructions, or all of them if @all is set
+static void clean_up_insns(struct entrypoint *ep, int all)
+{
+	int changed;
+
+	do {
+		struct basic_block *bb;
+
+		worklist_pending = false;
+		changed = 0;
+		FOR_EACH_PTR(ep->bbs, bb) {
+			struct instruction *insn;
+
+			if (!bb->queued && !all)
 				continue;
-			assert(insn->bb == bb);
-			cse_collect(insn);
-		} END_FOR_EACH_PTR(insn);
-	} END_FOR_EACH_PTR(bb);
+			bb->queued = 0;
+			FOR_EACH_PTR(bb->insns, insn) {
+				if (!insn->queued && !all)
+					continue;
+				insn->queued = 0;
+				if (!insn->bb)
+					continue;
+				changed |= simplify_one(insn);
+			} END_FOR_EACH_PTR(insn);
+		} END_FOR_EACH_PTR(bb);
+		all = 0;
+
+		// something queued without any changes shouldn't
+		// be retried until something else has changed.
+	} while (worklist_pending && changed);
 }
 
 static void cleanup_cfg(struct entrypoint *ep)
 {
+	start_timer(TIMER_CFG);
 	kill_unreachable_bbs(ep);
-	domtree_build(ep);
+	domtree_update(ep);
+	stop_timer(TIMER_CFG);
 }
 
 ///
@@ -61,48 +171,114 @@ void optimize(struct entrypoint *ep)
 	if (fdump_ir & PASS_LINEARIZE)
 		show_entry(ep);
 
+	start_timer(TIMER_CFG);
+	kill_unreachable_bbs(ep);
+	ir_validate(ep);
+	stop_timer(TIMER_CFG);
+
+	/*
+	 * Replace the calls to small functions by their body
+	 */
+	if (fpasses & PASS_INLINE) {
+		start_timer(TIMER_INLINE);
+		if (inline_calls(ep))
+			ir_validate(ep);
+		stop_timer(TIMER_INLINE);
+	}
+	if (fdump_ir & PASS_INLINE)
+		show_entry(ep);
+
 	/*
 	 * Do trivial flow simplification - branches to
 	 * branches, kill dead basicblocks etc
 	 */
-	kill_unreachable_bbs(ep);
-	ir_validate(ep);
-
+	start_timer(TIMER_CFG);
 	cfg_postorder(ep);
 	if (simplify_cfg_early(ep))
 		kill_unreachable_bbs(ep);
 	ir_validate(ep);
 
 	domtree_build(ep);
+	stop_timer(TIMER_CFG);
 
 	/*
 	 * Turn symbols into pseudos
 	 */
-	if (fpasses & PASS_MEM2REG)
+	if (fpasses & PASS_MEM2REG) {
+		start_timer(TIMER_SSA);
 		ssa_convert(ep);
+		stop_timer(TIMER_SSA);
+	}
 	ir_validate(ep);
 	if (fdump_ir & PASS_MEM2REG)
 		show_entry(ep);
 
+	/*
+	 * Propagate the constants over the whole CFG
+	 * and remove what is then unreachable.
+	 */
+	if (fpasses & PASS_SCCP) {
+		int changed;
+
+		start_timer(TIMER_SCCP);
+		changed = sccp(ep);
+		stop_timer(TIMER_SCCP);
+		if (changed & REPEAT_CFG_CLEANUP)
+			cleanup_cfg(ep);
+		ir_validate(ep);
+	}
+	if (fdump_ir & PASS_SCCP)
+		show_entry(ep);
+
+	/*
+	 * Remove the dead code left by the SSA conversion, before
+	 * the simplifications have to go through it.
+	 */
+	if (fpasses & PASS_DCE) {
+		start_timer(TIMER_DCE);
+		dce(ep);
+		stop_timer(TIMER_DCE);
+		ir_validate(ep);
+	}
+	if (fdump_ir & PASS_DCE)
+		show_entry(ep);
+
 	if (!(fpasses & PASS_OPTIM))
 		return;
+	worklist_active = true;
 repeat:
 	/*
 	 * Remove trivial instructions, and try to CSE
 	 * the rest.
 	 */
 	do {
+		int full = 1;
+
+		start_timer(TIMER_MEMOPS);
 		simplify_memops(ep);
+		stop_timer(TIMER_MEMOPS);
 		do {
 			repeat_phase = 0;
-			clean_up_insns(ep);
-			if (repeat_phase & REPEAT_CFG_CLEANUP)
+			start_timer(TIMER_SIMPLIFY);
+			clean_up_insns(ep, full);
+			stop_timer(TIMER_SIMPLIFY);
+			full = 0;
+			if (repeat_phase & REPEAT_CFG_CLEANUP) {
+				start_timer(TIMER_CFG);
 				kill_unreachable_bbs(ep);
+				stop_timer(TIMER_CFG);
+			}
 
+			start_timer(TIMER_CSE);
 			cse_eliminate(ep);
+			stop_timer(TIMER_CSE);
+			start_timer(TIMER_MEMOPS);
 			simplify_memops(ep);
+			stop_timer(TIMER_MEMOPS);
 		} while (repeat_phase);
+		start_timer(TIMER_CFG);
 		pack_basic_blocks(ep);
+		stop_timer(TIMER_CFG);
 		if (repeat_phase & REPEAT_CFG_CLEANUP)
 			cleanup_cfg(ep);
 	} while (repeat_phase);
@@ -113,7 +289,9 @@ repeat:
 	clear_symbol_pseudos(ep);
 
 	/* And track pseudo register usage */
+	start_timer(TIMER_LIVENESS);
 	track_pseudo_liveness(ep);
+	stop_timer(TIMER_LIVENESS);
 
 	/*
 	 * Some flow optimizations can only effectively
@@ -121,12 +299,30 @@ repeat:
 	 * if they trigger, we need to start all over
 	 * again
 	 */
+	start_timer(TIMER_CFG);
 	if (simplify_flow(ep)) {
+		stop_timer(TIMER_CFG);
 		clear_liveness(ep);
 		if (repeat_phase & REPEAT_CFG_CLEANUP)
 			cleanup_cfg(ep);
 		goto repeat;
 	}
+	stop_timer(TIMER_CFG);
+	worklist_active = false;
+
+	if (ftime_report) {
+		struct basic_block *bb;
+		struct instruction *insn;
+
+		FOR_EACH_PTR(ep->bbs, bb) {
+			FOR_EACH_PTR(bb->insns, insn) {
+				if (!insn->bb)
+					continue;
+				optimized_insns++;
+				optimized_calls += insn->opcode == OP_CALL;
+			} END_FOR_EACH_PTR(insn);
+		} END_FOR_EACH_PTR(bb);
+	}
 
 	/* Finally, add deathnotes to pseudos now that we have them */
 	if (dbg_dead)
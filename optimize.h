@@ -6,4 +6,8 @@ struct entrypoint;
 /* optimize.c */
 void optimize(struct entrypoint *ep);
 
+extern unsigned long simplify_visits;
+extern unsigned long optimized_insns;
+extern unsigned long optimized_calls;
+
 #endif
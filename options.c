@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 
 #ifndef __GNUC__
@@ -37,6 +38,7 @@ int gcc_patchlevel = __GNUC_PATCHLEVEL__;
 int has_error = 0;
 int optimize_level;
 int optimize_size;
+int parallel_jobs;
 int preprocess_only;
 int preprocessing;
 int verbose;
@@ -63,8 +65,10 @@ int arch_os = OS_NATIVE;
 int dbg_compound = 0;
 int dbg_dead = 0;
 int dbg_domtree = 0;
+int dbg_domtree_check = 0;
 int dbg_entry = 0;
 int dbg_ir = 0;
+int dbg_memops_index = 0;
 int dbg_postorder = 0;
 
 int dump_macro_defs = 0;
@@ -74,6 +78,8 @@ int dissect_show_all_symbols = 0;
 
 unsigned long fdump_ir;
 int fhosted = 1;
+int fhuge_pages = 0;
+unsigned int finline_ir_limit = 8;
 unsigned int fmax_errors = 100;
 unsigned int fmax_warnings = 100;
 int fmem_report = 0;
@@ -82,6 +88,11 @@ unsigned long fpasses = ~0UL;
 int fpic = 0;
 int fpie = 0;
 int fshort_wchar = 0;
+const char *fsummary_cache = NULL;
+int fsummaries = 1;
+int ftime_report = 0;
+unsigned int ftime_report_functions = 10;
+const char *ftoken_cache = NULL;
 int funsigned_bitfields = 0;
 int funsigned_char = 0;
 
@@ -468,6 +479,15 @@ static int handle_fpasses(const char *arg, const char *opt, const struct flag *f
 	return 0;
 }
 
+// for the passes whose -f<name> or -fno-<name> is also a GCC option,
+// like -fno-inline, only the suffixed forms are understood
+static int handle_fpasses_suffixed(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	if (*opt == '\0')
+		return 0;
+	return handle_fpasses(arg, opt, flag, options);
+}
+
 static int handle_fdiagnostic_prefix(const char *arg, const char *opt, const struct flag *flag, int options)
 {
 	switch (*opt) {
@@ -487,7 +507,10 @@ static int handle_fdump_ir(const char *arg, const char *opt, const struct flag *
 	static const struct mask_map dump_ir_options[] = {
 		{ "",			PASS_LINEARIZE },
 		{ "linearize",		PASS_LINEARIZE },
+		{ "inline",		PASS_INLINE },
 		{ "mem2reg",		PASS_MEM2REG },
+		{ "sccp",		PASS_SCCP },
+		{ "dce",		PASS_DCE },
 		{ "final",		PASS_FINAL },
 		{ },
 	};
@@ -501,6 +524,12 @@ static int handle_fmemcpy_max_count(const char *arg, const char *opt, const stru
 	return 1;
 }
 
+static int handle_finline_ir_limit(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	opt_uint(arg, opt, &finline_ir_limit, 0);
+	return 1;
+}
+
 static int handle_fmax_errors(const char *arg, const char *opt, const struct flag *flag, int options)
 {
 	opt_uint(arg, opt, &fmax_errors, OPTNUM_UNLIMITED);
@@ -513,19 +542,62 @@ static int handle_fmax_warnings(const char *arg, const char *opt, const struct f
 	return 1;
 }
 
+static int handle_ftime_report(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	if (options & OPT_INVERSE) {
+		ftime_report = 0;
+		return 1;
+	}
+	switch (*opt) {
+	case '=':
+		opt_uint(arg, opt+1, &ftime_report_functions, 0);
+		/* fall through */
+	case '\0':
+		ftime_report = 1;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int handle_ftoken_cache(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	if (*opt == '\0')
+		die("error: missing argument to \"%s\"", arg);
+	ftoken_cache = opt;
+	return 1;
+}
+
+static int handle_fsummary_cache(const char *arg, const char *opt, const struct flag *flag, int options)
+{
+	if (*opt == '\0')
+		die("error: missing argument to \"%s\"", arg);
+	fsummary_cache = opt;
+	return 1;
+}
+
 static struct flag fflags[] = {
 	{ "diagnostic-prefix",	NULL,	handle_fdiagnostic_prefix },
 	{ "dump-ir",		NULL,	handle_fdump_ir },
 	{ "freestanding",	&fhosted, NULL, OPT_INVERSE },
 	{ "hosted",		&fhosted },
+	{ "huge-pages",		&fhuge_pages },
+	{ "inline-ir-limit=",	NULL,	handle_finline_ir_limit },
 	{ "linearize",		NULL,	handle_fpasses,	PASS_LINEARIZE },
 	{ "max-errors=",	NULL,	handle_fmax_errors },
 	{ "max-warnings=",	NULL,	handle_fmax_warnings },
 	{ "mem-report",		&fmem_report },
 	{ "memcpy-max-count=",	NULL,	handle_fmemcpy_max_count },
+	{ "summaries",		&fsummaries },
+	{ "summary-cache=",	NULL,	handle_fsummary_cache },
 	{ "tabstop=",		NULL,	handle_ftabstop },
+	{ "time-report",	NULL,	handle_ftime_report },
+	{ "token-cache=",	NULL,	handle_ftoken_cache },
+	{ "inline",		NULL,	handle_fpasses_suffixed, PASS_INLINE },
 	{ "mem2reg",		NULL,	handle_fpasses,	PASS_MEM2REG },
 	{ "optim",		NULL,	handle_fpasses,	PASS_OPTIM },
+	{ "sccp",		NULL,	handle_fpasses,	PASS_SCCP },
+	{ "dce",		NULL,	handle_fpasses_suffixed, PASS_DCE },
 	{ "pic",		&fpic,	handle_switch_setval, 1 },
 	{ "PIC",		&fpic,	handle_switch_setval, 2 },
 	{ "pie",		&fpie,	handle_switch_setval, 1 },
@@ -617,6 +689,29 @@ static char **handle_switch_i(char *arg, char **next)
 	return next;
 }
 
+static char **handle_switch_j(char *arg, char **next)
+{
+	const char *val = arg + 1;
+	char *end;
+	long nr;
+
+	// only a number is a count: 'sparse -j 2nd.c' checks '2nd.c'
+	if (!*val && next[1] && next[1][0] &&
+	    !next[1][strspn(next[1], "0123456789")])
+		val = *++next;
+	if (!*val) {
+		// no count: one job per CPU
+		nr = sysconf(_SC_NPROCESSORS_ONLN);
+		parallel_jobs = nr > 0 ? nr : 1;
+		return next;
+	}
+	nr = strtol(val, &end, 10);
+	if (*end || nr < 1)
+		die("error: wrong argument to '-j'");
+	parallel_jobs = nr;
+	return next;
+}
+
 static char **handle_switch_M(char *arg, char **next)
 {
 	if (!strcmp(arg, "MF") || !strcmp(arg,"MQ") || !strcmp(arg,"MT")) {
@@ -819,8 +914,10 @@ static struct flag debugs[] = {
 	{ "compound", &dbg_compound},
 	{ "dead", &dbg_dead},
 	{ "domtree", &dbg_domtree},
+	{ "domtree-check", &dbg_domtree_check},
 	{ "entry", &dbg_entry},
 	{ "ir", &dbg_ir},
+	{ "memops-index", &dbg_memops_index},
 	{ "postorder", &dbg_postorder},
 	{ }
 };
@@ -1033,6 +1130,7 @@ char **handle_switch(char *arg, char **next)
 	case 'G': return handle_switch_G(arg, next);
 	case 'I': return handle_switch_I(arg, next);
 	case 'i': return handle_switch_i(arg, next);
+	case 'j': return handle_switch_j(arg, next);
 	case 'M': return handle_switch_M(arg, next);
 	case 'm': return handle_switch_m(arg, next);
 	case 'n': return handle_switch_n(arg, next);
@@ -36,6 +36,7 @@ extern int gcc_minor;
 extern int gcc_patchlevel;
 extern int optimize_level;
 extern int optimize_size;
+extern int parallel_jobs;
 extern int preprocess_only;
 extern int preprocessing;
 extern int repeat_phase;
@@ -63,8 +64,10 @@ extern int arch_os;
 extern int dbg_compound;
 extern int dbg_dead;
 extern int dbg_domtree;
+extern int dbg_domtree_check;
 extern int dbg_entry;
 extern int dbg_ir;
+extern int dbg_memops_index;
 extern int dbg_postorder;
 
 extern int dump_macro_defs;
@@ -74,6 +77,8 @@ extern int dissect_show_all_symbols;
 
 extern unsigned long fdump_ir;
 extern int fhosted;
+extern int fhuge_pages;
+extern unsigned int finline_ir_limit;
 extern unsigned int fmax_errors;
 extern unsigned int fmax_warnings;
 extern int fmem_report;
@@ -82,6 +87,11 @@ extern unsigned long fpasses;
 extern int fpic;
 extern int fpie;
 extern int fshort_wchar;
+extern const char *fsummary_cache;
+extern int fsummaries;
+extern int ftime_report;
+extern unsigned int ftime_report_functions;
+extern const char *ftoken_cache;
 extern int funsigned_bitfields;
 extern int funsigned_char;
 
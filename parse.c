@@ -542,6 +542,7 @@ static struct init_keyword {
 	D("safe",		&attr_mod_op,		.mods = MOD_SAFE),
 	D("unused",		&attr_mod_op,		.mods = MOD_UNUSED),
 	D("externally_visible",	&attr_mod_op,		.mods = MOD_EXT_VISIBLE),
+	D("weak",		&attr_mod_op,		.mods = MOD_WEAK),
 	D("force",		&attr_force_op),
 	D("bitwise",		&attr_bitwise_op,	.mods = MOD_BITWISE),
 	D("address_space",	&address_space_op),
@@ -30,7 +30,10 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -808,9 +811,12 @@ static const char *token_name_sequence(struct token *token, int endop, struct to
 
 static int already_tokenized(const char *path)
 {
+	int *hash = hash_stream(path);
 	int stream, next;
 
-	for (stream = *hash_stream(path); stream >= 0 ; stream = next) {
+	if (!hash)
+		return 0;
+	for (stream = *hash; stream >= 0 ; stream = next) {
 		struct stream *s = input_streams + stream;
 
 		next = s->next_stream;
@@ -896,6 +902,142 @@ static void set_stream_include_path(struct stream *stream)
 	includepath[0] = path;
 }
 
+/*
+ * Cache of the content of the include directories.
+ *
+ * Most of the open() done while searching the include paths fail,
+ * simply because the file is in a directory later in the chain.
+ * To avoid these, each directory searched is read once and the
+ * names it contains are kept in a sorted table: open() is then only
+ * done when the file, and each of its leading components, exist.
+ *
+ * If a directory can't be read (but may exist) its content is
+ * unknown and open() is always tried.
+ *
+ * The names are compared without regard to case: on case-insensitive
+ * filesystems, "Foo.h" opens foo.h. On the others, such a name only
+ * costs an open() that fails.
+ */
+struct include_dir {
+	struct include_dir *next;
+	const char *name;
+	int len;
+	int known;
+	int nr;
+	char **entries;
+};
+
+#define INCLUDE_DIR_HASH_BITS 7
+#define INCLUDE_DIR_HASH_SIZE (1 << INCLUDE_DIR_HASH_BITS)
+
+static struct include_dir *include_dir_hash[INCLUDE_DIR_HASH_SIZE];
+
+static int include_opens, include_avoided, include_dirs;
+
+static int compare_entries(const void *a, const void *b)
+{
+	return strcasecmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void read_include_dir(struct include_dir *dir)
+{
+	struct dirent *de;
+	int alloc = 0;
+	DIR *d;
+
+	d = opendir(dir->len ? dir->name : ".");
+	if (!d) {
+		// a missing directory contains nothing
+		dir->known = errno == ENOENT || errno == ENOTDIR;
+		return;
+	}
+	include_dirs++;
+	while ((de = readdir(d)) != NULL) {
+		if (dir->nr == alloc) {
+			alloc = alloc * 2 + 64;
+			dir->entries = realloc(dir->entries, alloc * sizeof(char *));
+			if (!dir->entries)
+				die("out of memory");
+		}
+		dir->entries[dir->nr++] = xstrdup(de->d_name);
+	}
+	closedir(d);
+	qsort(dir->entries, dir->nr, sizeof(char *), compare_entries);
+	dir->known = 1;
+}
+
+static struct include_dir *lookup_include_dir(const char *name, int len)
+{
+	unsigned long hash = len;
+	struct include_dir *dir, **bucket;
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = hash * 31 + (unsigned char)name[i];
+	hash *= 0x9e370001UL;
+	bucket = &include_dir_hash[(hash >> 16) & (INCLUDE_DIR_HASH_SIZE - 1)];
+
+	for (dir = *bucket; dir; dir = dir->next) {
+		if (dir->len == len && !memcmp(dir->name, name, len))
+			return dir;
+	}
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		die("out of memory");
+	dir->name = xmemdup(name, len + 1);
+	((char *)dir->name)[len] = '\0';
+	dir->len = len;
+	read_include_dir(dir);
+	dir->next = *bucket;
+	*bucket = dir;
+	return dir;
+}
+
+static int include_dir_has(const char *fullname, int len, const char *name)
+{
+	struct include_dir *dir = lookup_include_dir(fullname, len);
+
+	if (!dir->known)
+		return 1;
+	return bsearch(&name, dir->entries, dir->nr, sizeof(char *), compare_entries) != NULL;
+}
+
+/*
+ * Check if the file 'fullname' may exist, by looking at
+ * the content of the directories after the first 'plen' bytes.
+ */
+static int include_may_exist(char *fullname, int plen)
+{
+	char *name = fullname + plen;
+
+	for (;;) {
+		char *slash = strchr(name, '/');
+		int found;
+
+		if (slash == name) {
+			name++;
+			continue;
+		}
+		if (slash)
+			*slash = '\0';
+		found = include_dir_has(fullname, name - fullname, name);
+		if (slash)
+			*slash = '/';
+		if (!found)
+			return 0;
+		if (!slash)
+			return 1;
+		name = slash + 1;
+	}
+}
+
+void show_include_stats(void)
+{
+	fprintf(stderr, "includes: %d opens, %d avoided, %d directories read\n",
+		include_opens, include_avoided, include_dirs);
+}
+
 static int try_include(struct position pos, const char *path, const char *filename, int flen, struct token **where, const char **next_path)
 {
 	int fd;
@@ -910,6 +1052,11 @@ static int try_include(struct position pos, const char *path, const char *filena
 	memcpy(fullname+plen, filename, flen);
 	if (already_tokenized(fullname))
 		return 1;
+	if (!include_may_exist(fullname, plen)) {
+		include_avoided++;
+		return 0;
+	}
+	include_opens++;
 	fd = open(fullname, O_RDONLY);
 	if (fd >= 0) {
 		char *streamname = xmemdup(fullname, plen + flen);
@@ -920,13 +1067,109 @@ static int try_include(struct position pos, const char *path, const char *filena
 	return 0;
 }
 
+/*
+ * Cache of the include path lookups.
+ *
+ * For a given search chain and filename, remember in which directory
+ * the file was found. Later includes of the same file can then go
+ * directly there, without probing again all the directories before it.
+ * In particular, once a file is known to be protected by an include
+ * guard, its repeated inclusions don't touch the filesystem anymore.
+ *
+ * Since the cache contains pointers into includepath[], it's flushed
+ * each time the include paths are modified.
+ */
+struct include_entry {
+	struct include_entry *next;
+	const char **chain;	// where the search started
+	const char *dir;	// the value of includepath[0], if searched
+	const char *filename;
+	const char *path;	// where the file was found
+	const char **next_path;
+};
+
+#define INCLUDE_HASH_BITS 9
+#define INCLUDE_HASH_SIZE (1 << INCLUDE_HASH_BITS)
+
+static struct include_entry *include_hash[INCLUDE_HASH_SIZE];
+
+static void flush_include_cache(void)
+{
+	int i;
+
+	for (i = 0; i < INCLUDE_HASH_SIZE; i++) {
+		struct include_entry *entry = include_hash[i];
+
+		while (entry) {
+			struct include_entry *next = entry->next;
+			free(entry);
+			entry = next;
+		}
+		include_hash[i] = NULL;
+	}
+}
+
+static struct include_entry **include_bucket(const char **chain, const char *filename)
+{
+	unsigned long hash = (unsigned long)chain;
+	unsigned char c;
+
+	while ((c = *filename++))
+		hash = hash * 31 + c;
+	hash *= 0x9e370001UL;
+	return &include_hash[(hash >> 16) & (INCLUDE_HASH_SIZE - 1)];
+}
+
+static struct include_entry *lookup_include(const char **chain, const char *filename)
+{
+	const char *dir = chain == includepath ? includepath[0] : NULL;
+	struct include_entry *entry;
+
+	for (entry = *include_bucket(chain, filename); entry; entry = entry->next) {
+		if (entry->chain != chain)
+			continue;
+		if (entry->dir != dir && (!dir || !entry->dir || strcmp(entry->dir, dir)))
+			continue;
+		if (strcmp(entry->filename, filename))
+			continue;
+		return entry;
+	}
+	return NULL;
+}
+
+static void add_include(const char **chain, const char *filename, int flen, const char **next_path)
+{
+	struct include_entry **bucket = include_bucket(chain, filename);
+	struct include_entry *entry = malloc(sizeof(*entry) + flen);
+
+	if (!entry)
+		return;
+	entry->chain = chain;
+	entry->dir = chain == includepath ? includepath[0] : NULL;
+	entry->filename = memcpy(entry + 1, filename, flen);
+	entry->path = next_path[-1];
+	entry->next_path = next_path;
+	entry->next = *bucket;
+	*bucket = entry;
+}
+
 static int do_include_path(const char **pptr, struct token **list, struct token *token, const char *filename, int flen)
 {
+	struct include_entry *entry = lookup_include(pptr, filename);
+	const char **chain = pptr;
 	const char *path;
 
+	if (entry) {
+		if (try_include(token->pos, entry->path, filename, flen, list, entry->next_path))
+			return 1;
+		// the file has disappeared? do the full search
+	}
+
 	while ((path = *pptr++) != NULL) {
 		if (!try_include(token->pos, path, filename, flen, list, pptr))
 			continue;
+		if (!entry)
+			add_include(chain, filename, flen, pptr);
 		return 1;
 	}
 	return 0;
@@ -1769,6 +2012,7 @@ static int handle_nostdinc(struct stream *stream, struct token **line, struct to
 	 * Clear them out if so..
 	 */
 	*sys_includepath = NULL;
+	flush_include_cache();
 	return 1;
 }
 
@@ -1826,6 +2070,7 @@ static void add_path_entry(struct token *token, const char *path,
 	dst = *where;
 
 	update_inc_ptrs(where);
+	flush_include_cache();
 
 	/*
 	 * Move them all up starting at dst,
@@ -1896,6 +2141,7 @@ static void add_dirafter_entry(struct token *token, const char *path)
 	*dst = path;
 	dst++;
 	*dst = NULL;
+	flush_include_cache();
 }
 
 static int handle_add_dirafter(struct stream *stream, struct token **line, struct token *token)
@@ -1928,6 +2174,7 @@ static int handle_split_include(struct stream *stream, struct token **line, stru
 	 */
 	quote_includepath = includepath+1;
 	angle_includepath = sys_includepath;
+	flush_include_cache();
 	return 1;
 }
 
@@ -2276,6 +2523,7 @@ static void do_preprocess(struct token **list)
 
 struct token * preprocess(struct token *token)
 {
+	start_timer(TIMER_PREPROCESS);
 	preprocessing = 1;
 	init_preprocessor();
 	do_preprocess(&token);
@@ -2284,6 +2532,7 @@ struct token * preprocess(struct token *token)
 	// This is not true when we have multiple files, though ;/
 	// clear_expression_alloc();
 	preprocessing = 0;
+	stop_timer(TIMER_PREPROCESS);
 
 	return token;
 }
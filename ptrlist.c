@@ -28,8 +28,57 @@
 #include "allocate.h"
 #include "compat.h"
 
-__DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
-__ALLOCATOR(struct ptr_list, "ptr list", ptrlist);
+#define PTRLIST_ALLOCATOR(bytes)					\
+	__DECLARE_ALLOCATOR(struct ptr_list, ptrlist##bytes)		\
+	__DO_ALLOCATOR(struct ptr_list, bytes, 64, "ptr list/" #bytes, ptrlist##bytes)
+
+PTRLIST_ALLOCATOR(64);
+PTRLIST_ALLOCATOR(128);
+PTRLIST_ALLOCATOR(256);
+PTRLIST_ALLOCATOR(512);
+
+///
+// allocate a new block for a ptrlist
+// @nr: the number of entries the block should hold
+// @return: the smallest block that can hold @nr entries,
+//	or the biggest one if none can.
+static struct ptr_list *alloc_ptr_block(int nr)
+{
+	struct ptr_list *list;
+
+	if (nr <= LIST_BLOCK_SIZE(64)) {
+		list = __alloc_ptrlist64(0);
+		list->cap = LIST_BLOCK_SIZE(64);
+	} else if (nr <= LIST_BLOCK_SIZE(128)) {
+		list = __alloc_ptrlist128(0);
+		list->cap = LIST_BLOCK_SIZE(128);
+	} else if (nr <= LIST_BLOCK_SIZE(256)) {
+		list = __alloc_ptrlist256(0);
+		list->cap = LIST_BLOCK_SIZE(256);
+	} else {
+		list = __alloc_ptrlist512(0);
+		list->cap = LIST_BLOCK_SIZE(512);
+	}
+	return list;
+}
+
+static void free_ptr_block(struct ptr_list *list)
+{
+	switch (list->cap) {
+	case LIST_BLOCK_SIZE(64):
+		__free_ptrlist64(list);
+		break;
+	case LIST_BLOCK_SIZE(128):
+		__free_ptrlist128(list);
+		break;
+	case LIST_BLOCK_SIZE(256):
+		__free_ptrlist256(list);
+		break;
+	default:
+		__free_ptrlist512(list);
+		break;
+	}
+}
 
 ///
 // get the size of a ptrlist
@@ -205,14 +254,14 @@ restart:
 			if (!entry->nr) {
 				struct ptr_list *prev;
 				if (next == entry) {
-					__free_ptrlist(entry);
+					free_ptr_block(entry);
 					*listp = NULL;
 					return;
 				}
 				prev = entry->prev;
 				prev->next = next;
 				next->prev = prev;
-				__free_ptrlist(entry);
+				free_ptr_block(entry);
 				if (entry == head) {
 					*listp = next;
 					head = next;
@@ -235,7 +284,7 @@ restart:
 void split_ptr_list_head(struct ptr_list *head)
 {
 	int old = head->nr, nr = old / 2;
-	struct ptr_list *newlist = __alloc_ptrlist(0);
+	struct ptr_list *newlist = alloc_ptr_block(head->cap);
 	struct ptr_list *next = head->next;
 
 	old -= nr;
@@ -262,10 +311,14 @@ void **__add_ptr_list(struct ptr_list **listp, void *ptr)
 	struct ptr_list *list = *listp;
 	struct ptr_list *last = NULL; /* gcc complains needlessly */
 	void **ret;
-	int nr;
+	int nr = 0;
 
-	if (!list || (nr = (last = list->prev)->nr) >= LIST_NODE_NR) {
-		struct ptr_list *newlist = __alloc_ptrlist(0);
+	if (list) {
+		last = list->prev;
+		nr = last->nr;
+	}
+	if (!list || nr >= last->cap) {
+		struct ptr_list *newlist = alloc_ptr_block(list ? last->cap + 1 : 1);
 		if (!list) {
 			newlist->next = newlist;
 			newlist->prev = newlist;
@@ -417,7 +470,7 @@ void * delete_ptr_list_last(struct ptr_list **head)
 		last->prev->next = first;
 		if (last == first)
 			*head = NULL;
-		__free_ptrlist(last);
+		free_ptr_block(last);
 	}
 	return ptr;
 }
@@ -463,9 +516,9 @@ void copy_ptr_list(struct ptr_list **listp, struct ptr_list *src)
 			void *ptr = cur->list[i++];
 			if (!ptr)
 				continue;
-			if (idx >= LIST_NODE_NR) {
+			if (idx >= tail->cap) {
 				struct ptr_list *prev = tail;
-				tail = __alloc_ptrlist(0);
+				tail = alloc_ptr_block(prev->cap + 1);
 				prev->next = tail;
 				tail->prev = prev;
 				prev->nr = idx;
@@ -475,7 +528,7 @@ void copy_ptr_list(struct ptr_list **listp, struct ptr_list *src)
 		}
 
 		next = cur->next;
-		__free_ptrlist(cur);
+		free_ptr_block(cur);
 		cur = next;
 	} while (cur != src);
 
@@ -503,7 +556,7 @@ void __free_ptr_list(struct ptr_list **listp)
 	while (list) {
 		tmp = list;
 		list = list->next;
-		__free_ptrlist(tmp);
+		free_ptr_block(tmp);
 	}
 
 	*listp = NULL;
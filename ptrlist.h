@@ -15,19 +15,27 @@
 #define PTRLIST_TYPE(head)		__typeof__((head)->list[0])
 #define VRFY_PTR_LIST(head)		(void)(sizeof((head)->list[0]))
 
-#define LIST_NODE_NR (13)
-
+/*
+ * The blocks of a list don't all have the same size: most lists
+ * only have one or two entries, so the first block is small, the
+ * following ones are bigger and bigger, up to LIST_NODE_MAX entries.
+ * The block sizes are multiple of a cache line.
+ */
 #define DECLARE_PTR_LIST(listname, type)	\
 	struct listname {			\
 		int nr:8;			\
 		int rm:8;			\
+		int cap:8;			\
 		struct listname *prev;		\
 		struct listname *next;		\
-		type *list[LIST_NODE_NR];	\
+		type *list[];			\
 	}
 
 DECLARE_PTR_LIST(ptr_list, void);
 
+#define LIST_BLOCK_SIZE(bytes)	(((bytes) - sizeof(struct ptr_list)) / sizeof(void *))
+#define LIST_NODE_MAX		LIST_BLOCK_SIZE(512)
+
 
 void * undo_ptr_list_last(struct ptr_list **head);
 void * delete_ptr_list_last(struct ptr_list **head);
@@ -264,7 +272,7 @@ extern void split_ptr_list_head(struct ptr_list *);
 
 #define DO_INSERT_CURRENT(new, __head, __list, __nr) do {		\
 	PTRLIST_TYPE(__head) *__this, *__last;				\
-	if (__list->nr == LIST_NODE_NR) {				\
+	if (__list->nr == __list->cap) {				\
 		split_ptr_list_head((struct ptr_list*)__list);		\
 		if (__nr >= __list->nr) {				\
 			__nr -= __list->nr;				\
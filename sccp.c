@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: MIT
+//
+// Sparse conditional constant propagation
+//
+// This is the classic algorithm from Wegman & Zadeck: the pseudos are
+// given a value in a lattice (unknown yet, constant or varying) while
+// only the BBs found to be executable are taken in account. Since this
+// is optimistic and done on the whole CFG at once, it finds constants
+// and unreachable code that the local simplifications can't, like a
+// variable keeping the same value in a loop or a branch only
+// depending on such variables.
+//
+// The value of a pseudo is kept in its ->priv:
+// * NULL:		unknown yet (top)
+// * a PSEUDO_VAL:	a constant
+// * anything else:	varying (bottom), the pseudo itself is used.
+
+#include "sccp.h"
+#include "lib.h"
+#include "linearize.h"
+#include "simplify.h"
+#include "flow.h"
+
+
+// the generation of the BBs found to be executable, and then visited
+static unsigned long executable, visited;
+static struct basic_block_list *bb_worklist;
+static struct instruction_list *insn_worklist;
+
+static inline bool is_executable(struct basic_block *bb)
+{
+	return bb && (bb->generation == executable || bb->generation == visited);
+}
+
+static inline bool is_const(pseudo_t val)
+{
+	return val && val->type == PSEUDO_VAL;
+}
+
+static pseudo_t value_of(pseudo_t p)
+{
+	switch (p->type) {
+	case PSEUDO_VAL:
+		return p;
+	case PSEUDO_REG:
+	case PSEUDO_PHI:
+		return p->priv;
+	default:
+		return p;
+	}
+}
+
+///
+// combine the values coming from two different paths
+static pseudo_t meet(pseudo_t a, pseudo_t b, pseudo_t varying)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	if (is_const(a) && is_const(b) && a->value == b->value)
+		return a;
+	return varying;
+}
+
+static void set_value(pseudo_t p, pseudo_t val)
+{
+	pseudo_t old = p->priv;
+	struct pseudo_user *pu;
+
+	if (!val)
+		return;
+	if (p->type != PSEUDO_REG && p->type != PSEUDO_PHI)
+		return;
+	if (old) {
+		if (!is_const(old))
+			return;		// already varying
+		if (is_const(val) && val->value == old->value)
+			return;
+		val = p;
+	} else if (!is_const(val)) {
+		val = p;
+	}
+	p->priv = val;
+
+	// the users in the BBs not yet visited will be seen anyway
+	FOR_EACH_PTR(p->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (insn->bb && insn->bb->generation == visited)
+			add_instruction(&insn_worklist, insn);
+	} END_FOR_EACH_PTR(pu);
+}
+
+static struct basic_block *switch_target(struct instruction *insn, long long val)
+{
+	struct multijmp *jmp;
+
+	FOR_EACH_PTR(insn->multijmp_list, jmp) {
+		/* Default case */
+		if (jmp->begin > jmp->end)
+			return jmp->target;
+		if (val >= jmp->begin && val <= jmp->end)
+			return jmp->target;
+	} END_FOR_EACH_PTR(jmp);
+	return NULL;
+}
+
+///
+// return the only child of a BB which can be executed, if known
+static struct basic_block *known_target(struct instruction *br)
+{
+	pseudo_t cond;
+
+	switch (br->opcode) {
+	case OP_BR:
+		return br->bb_true;
+	case OP_CBR:
+		cond = value_of(br->cond);
+		if (!is_const(cond))
+			return NULL;
+		return cond->value ? br->bb_true : br->bb_false;
+	case OP_SWITCH:
+		cond = value_of(br->cond);
+		if (!is_const(cond))
+			return NULL;
+		return switch_target(br, cond->value);
+	}
+	return NULL;
+}
+
+static bool edge_executable(struct basic_block *from, struct basic_block *to)
+{
+	struct basic_block *target;
+
+	if (!from || from->generation != visited)
+		return false;
+	target = known_target(last_instruction(from->insns));
+	return !target || target == to;
+}
+
+static void mark_edge(struct basic_block *from, struct basic_block *to)
+{
+	struct instruction *insn;
+
+	if (!is_executable(to)) {
+		to->generation = executable;
+		add_bb(&bb_worklist, to);
+		return;
+	}
+	if (to->generation != visited && to != from)
+		return;
+
+	// a new path to a visited BB: its phi-nodes must be revisited
+	FOR_EACH_PTR(to->insns, insn) {
+		if (insn->bb && insn->opcode == OP_PHI)
+			add_instruction(&insn_worklist, insn);
+	} END_FOR_EACH_PTR(insn);
+}
+
+static void visit_branch(struct instruction *br)
+{
+	struct basic_block *bb = br->bb;
+	struct basic_block *child;
+
+	child = known_target(br);
+	if (child) {
+		mark_edge(bb, child);
+		return;
+	}
+	FOR_EACH_PTR(bb->children, child) {
+		mark_edge(bb, child);
+	} END_FOR_EACH_PTR(child);
+}
+
+static pseudo_t eval_phi(struct instruction *insn)
+{
+	pseudo_t val = NULL;
+	pseudo_t phi;
+
+	FOR_EACH_PTR(insn->phi_list, phi) {
+		struct instruction *def;
+
+		if (phi == VOID)
+			continue;
+		def = phi->def;
+		if (!edge_executable(def->bb, insn->bb))
+			continue;
+		val = meet(val, value_of(phi), insn->target);
+	} END_FOR_EACH_PTR(phi);
+	return val;
+}
+
+static pseudo_t eval_sel(struct instruction *insn)
+{
+	pseudo_t cond = value_of(insn->src1);
+
+	if (!cond)
+		return NULL;
+	if (is_const(cond))
+		return value_of(cond->value ? insn->src2 : insn->src3);
+	return meet(value_of(insn->src2), value_of(insn->src3), insn->target);
+}
+
+static pseudo_t eval_expr(struct instruction *insn)
+{
+	pseudo_t src1 = value_of(insn->src1);
+	pseudo_t src2 = VOID;
+	pseudo_t res;
+
+	if (opcode_table[insn->opcode].flags & OPF_BINOP)
+		src2 = value_of(insn->src2);
+	if (!src1 || !src2)
+		return NULL;
+	if (!is_const(src1) || (src2 != VOID && !is_const(src2)))
+		return insn->target;
+	res = eval_constant(insn, src1, src2);
+	return res ? res : insn->target;
+}
+
+static void visit_insn(struct instruction *insn)
+{
+	pseudo_t val;
+
+	switch (insn->opcode) {
+	case OP_BR: case OP_CBR: case OP_SWITCH:
+	case OP_COMPUTEDGOTO:
+		visit_branch(insn);
+		return;
+	case OP_PHI:
+		val = eval_phi(insn);
+		break;
+	case OP_PHISOURCE:
+	case OP_COPY:
+		val = value_of(insn->src1);
+		break;
+	case OP_SEL:
+		val = eval_sel(insn);
+		break;
+	case OP_BINARY ... OP_BINARY_END:
+	case OP_BINCMP ... OP_BINCMP_END:
+	case OP_NOT: case OP_NEG:
+	case OP_SEXT: case OP_ZEXT: case OP_TRUNC:
+		val = eval_expr(insn);
+		break;
+	default:
+		if (!has_target(insn))
+			return;
+		val = insn->target;
+		break;
+	}
+	set_value(insn->target, val);
+}
+
+static void visit_bb(struct basic_block *bb)
+{
+	struct instruction *insn;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!insn->bb)
+			continue;
+		visit_insn(insn);
+	} END_FOR_EACH_PTR(insn);
+	bb->generation = visited;
+}
+
+static void propagate(struct entrypoint *ep)
+{
+	executable = ++bb_generation;
+	visited = ++bb_generation;
+	mark_edge(NULL, ep->entry->bb);
+
+	for (;;) {
+		struct instruction *insn;
+		struct basic_block *bb;
+
+		if ((insn = delete_last_instruction(&insn_worklist))) {
+			if (insn->bb)
+				visit_insn(insn);
+			continue;
+		}
+		if ((bb = delete_last_basic_block(&bb_worklist))) {
+			visit_bb(bb);
+			continue;
+		}
+		break;
+	}
+	free_ptr_list(&insn_worklist);
+	free_ptr_list(&bb_worklist);
+}
+
+///
+// replace the pseudos found to be constant and the branches
+// which can only go one way.
+static int rewrite(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+	int changed = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+
+		if (!is_executable(bb))
+			continue;
+		FOR_EACH_PTR(bb->insns, insn) {
+			pseudo_t val;
+
+			if (!has_target(insn))
+				continue;
+			// only the targets in the visited BBs have a value
+			val = insn->target->priv;
+			insn->target->priv = NULL;
+			if (!insn->bb || insn->opcode == OP_PHISOURCE)
+				continue;
+			if (!is_const(val))
+				continue;
+			changed |= replace_with_pseudo(insn, val);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *br;
+		struct basic_block *target;
+
+		if (!is_executable(bb))
+			continue;
+		br = last_instruction(bb->insns);
+		if (!br || (br->opcode != OP_CBR && br->opcode != OP_SWITCH))
+			continue;
+		target = known_target(br);
+		if (target)
+			changed |= convert_to_jump(br, target);
+	} END_FOR_EACH_PTR(bb);
+
+	return changed;
+}
+
+int sccp(struct entrypoint *ep)
+{
+	propagate(ep);
+	return rewrite(ep);
+}
@@ -48,6 +48,7 @@
 #include "flow.h"
 #include "symbol.h"
 #include "flowgraph.h"
+#include "summary.h"
 
 ///
 // Utilities
@@ -273,6 +274,13 @@ static inline void rem_usage(pseudo_t p, pseudo_t *usep, int kill)
 		delete_pseudo_user_list_entry(&p->users, usep, 1);
 		if (kill && !p->users && has_definition(p))
 			kill_instruction(p->def);
+		else if (worklist_active && one_use(p)) {
+			// the simplifications needing a single use
+			// may now apply to the remaining user
+			if (has_definition(p))
+				queue_instruction(p->def);
+			queue_users(p);
+		}
 	}
 }
 
@@ -359,9 +367,7 @@ int kill_insn(struct instruction *insn, int force)
 	case OP_CALL:
 		if (!force) {
 			/* a "pure" function can be killed too */
-			struct symbol *fntype = first_symbol(insn->fntypes);
-
-			if (!(fntype->ctype.modifiers & MOD_PURE))
+			if (!call_is_pure(insn))
 				return 0;
 		}
 		kill_use_list(insn->arguments);
@@ -404,11 +410,6 @@ int kill_insn(struct instruction *insn, int force)
 	return repeat_phase |= REPEAT_CSE;
 }
 
-static inline bool has_target(struct instruction *insn)
-{
-	return opcode_table[insn->opcode].flags & OPF_TARGET;
-}
-
 void remove_dead_insns(struct entrypoint *ep)
 {
 	struct basic_block *bb;
@@ -880,13 +881,38 @@ static int simplify_mask_shift(struct instruction *sh, unsigned long long mask)
 	return 0;
 }
 
-static pseudo_t eval_insn(struct instruction *insn)
+///
+// evaluate an instruction for some constant operands
+// @src1, @src2: the values to use for the operands (VOID if unused)
+// @return: the resulting value or NULL if it can't be evaluated.
+pseudo_t eval_constant(struct instruction *insn, pseudo_t src1, pseudo_t src2)
 {
 	unsigned size = insn->size;
+	long long val, mask;
+
+	switch (insn->opcode) {
+	case OP_SEXT:
+		val = src1->value;
+		mask = 1ULL << (insn->orig_type->bit_size-1);
+		if (val & mask)
+			val |= ~(mask | (mask-1));
+		break;
+	case OP_ZEXT:
+	case OP_TRUNC:
+		val = src1->value;
+		break;
+	default:
+		if (opcode_table[insn->opcode].flags & OPF_COMPARE)
+			size = insn->itype->bit_size;
+		return eval_op(insn->opcode, size, src1, src2);
+	}
+	mask = 1ULL << (size-1);
+	return value_pseudo(val & (mask | (mask-1)));
+}
 
-	if (opcode_table[insn->opcode].flags & OPF_COMPARE)
-		size = insn->itype->bit_size;
-	return eval_op(insn->opcode, size, insn->src1, insn->src2);
+static inline pseudo_t eval_insn(struct instruction *insn)
+{
+	return eval_constant(insn, insn->src1, insn->src2);
 }
 
 static long long check_shift_count(struct instruction *insn, unsigned long long uval)
@@ -1654,7 +1680,8 @@ static int simplify_binop_same_args(struct instruction *insn, pseudo_t arg)
 	case OP_SET_NE:
 	case OP_SET_LT: case OP_SET_GT:
 	case OP_SET_B:  case OP_SET_A:
-		if (Wtautological_compare)
+		// already warned about in the inlined function
+		if (Wtautological_compare && !insn->inlined)
 			warning(insn->pos, "self-comparison always evaluates to false");
 	case OP_SUB:
 	case OP_XOR:
@@ -1663,7 +1690,7 @@ static int simplify_binop_same_args(struct instruction *insn, pseudo_t arg)
 	case OP_SET_EQ:
 	case OP_SET_LE: case OP_SET_GE:
 	case OP_SET_BE: case OP_SET_AE:
-		if (Wtautological_compare)
+		if (Wtautological_compare && !insn->inlined)
 			warning(insn->pos, "self-comparison always evaluates to true");
 		return replace_with_value(insn, 1);
 
@@ -2098,32 +2125,11 @@ static int simplify_xor(struct instruction *insn)
 
 static int simplify_constant_unop(struct instruction *insn)
 {
-	long long val = insn->src1->value;
-	long long res, mask;
+	pseudo_t res = eval_constant(insn, insn->src1, VOID);
 
-	switch (insn->opcode) {
-	case OP_NOT:
-		res = ~val;
-		break;
-	case OP_NEG:
-		res = -val;
-		break;
-	case OP_SEXT:
-		mask = 1ULL << (insn->orig_type->bit_size-1);
-		if (val & mask)
-			val |= ~(mask | (mask-1));
-		/* fall through */
-	case OP_ZEXT:
-	case OP_TRUNC:
-		res = val;
-		break;
-	default:
+	if (!res)
 		return 0;
-	}
-	mask = 1ULL << (insn->size-1);
-	res &= mask | (mask-1);
-	
-	return replace_with_value(insn, res);
+	return replace_with_pseudo(insn, res);
 }
 
 static int simplify_unop(struct instruction *insn)
@@ -2231,7 +2237,8 @@ offset:
 		 */
 		if (repeat_phase & REPEAT_CFG_CLEANUP)
 			return 0;
-		warning(insn->pos, "crazy programmer");
+		if (!insn->inlined)
+			warning(insn->pos, "crazy programmer");
 		replace_pseudo(insn, &insn->src, VOID);
 		return 0;
 	}
@@ -2661,7 +2668,8 @@ static int simplify_switch(struct instruction *insn)
 		if (val >= jmp->begin && val <= jmp->end)
 			goto found;
 	} END_FOR_EACH_PTR(jmp);
-	warning(insn->pos, "Impossible case statement");
+	if (!insn->inlined)
+		warning(insn->pos, "Impossible case statement");
 	return 0;
 
 found:
@@ -2702,6 +2710,7 @@ static int simplify_cgoto(struct instruction *insn)
 				continue;
 			remove_bb_from_list(&jmp->target->parents, bb, 1);
 			remove_bb_from_list(&bb->children, jmp->target, 1);
+			domtree_delete_edge(bb, jmp->target);
 			DELETE_CURRENT_PTR(jmp);
 		} END_FOR_EACH_PTR(jmp);
 		kill_use(&insn->src);
@@ -38,7 +38,7 @@ static unsigned char been_there[256];
 #define BEEN_THERE(_c) do { } while (0)
 #endif
 
-// Sort one fragment.  LIST_NODE_NR (==29) is a bit too high for my
+// Sort one fragment.  LIST_NODE_MAX (==61) is a bit too high for my
 // taste for something this simple.  But, hey, it's O(1).
 //
 // I would use libc qsort for this, but its comparison function
@@ -119,7 +119,7 @@ merge_block_seqs (struct ptr_list *b1, int n,
 		  int (*cmp)(const void *, const void *))
 {
 	int i1 = 0, i2 = 0;
-	const void *buffer[2 * LIST_NODE_NR];
+	const void *buffer[2 * LIST_NODE_MAX];
 	int nbuf = 0;
 	struct ptr_list *newhead = b1;
 
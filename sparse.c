@@ -31,6 +31,8 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -39,6 +41,7 @@
 #include "symbol.h"
 #include "expression.h"
 #include "linearize.h"
+#include "summary.h"
 
 static int context_increase(struct basic_block *bb, int entry)
 {
@@ -49,6 +52,10 @@ static int context_increase(struct basic_block *bb, int entry)
 		int val;
 		if (!insn->bb)
 			continue;
+		if (insn->opcode == OP_CALL) {
+			sum += call_context(insn);
+			continue;
+		}
 		if (insn->opcode != OP_CONTEXT)
 			continue;
 		val = insn->increment;
@@ -225,7 +232,7 @@ static void check_bb_instructions(struct basic_block *bb)
 {
 	struct instruction *insn;
 	FOR_EACH_PTR(bb->insns, insn) {
-		if (!insn->bb)
+		if (!insn->bb || insn->inlined)
 			continue;
 		check_one_instruction(insn);
 	} END_FOR_EACH_PTR(insn);
@@ -302,22 +309,147 @@ static void check_symbols(struct symbol_list *list)
 	FOR_EACH_PTR(list, sym) {
 		struct entrypoint *ep;
 
+		start_function_timer();
 		expand_symbol(sym);
+		mark_ir_allocations();
 		ep = linearize_symbol(sym);
 		if (ep && ep->entry) {
 			if (dbg_entry)
 				show_entry(ep);
 
+			start_timer(TIMER_CHECK);
 			check_context(ep);
+			stop_timer(TIMER_CHECK);
 		}
 		if (dbg_compound)
 			list_compound_symbol(sym);
+		if (ep)
+			stop_function_timer(sym);
+		release_ir_allocations(ep);
 	} END_FOR_EACH_PTR(sym);
 
 	if (Wsparse_error && die_if_error)
 		exit(1);
 }
 
+/*
+ * Parallel checking (-j N).
+ *
+ * Each file is checked in its own process, forked once the initial
+ * setup (predefines, builtins, -include files, ...) is done, so that
+ * this state is shared copy-on-write between all the files.
+ * The output of each child is collected in temporary files and then
+ * copied back in the order of the command line, so the result is the
+ * same as when checking the files one after the other.
+ * The statistics (-fmem-report, ...) are also given by each child,
+ * for its own file.
+ */
+struct job {
+	pid_t pid;
+	FILE *out, *err;
+	int status;
+	int done;
+};
+
+static void copy_output(FILE *from, FILE *to)
+{
+	char buf[4096];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, n, to);
+	fclose(from);
+}
+
+static void start_job(struct job *job, char *file)
+{
+	job->out = tmpfile();
+	job->err = tmpfile();
+	if (!job->out || !job->err)
+		die("error: cannot create temporary file");
+
+	fflush(stdout);
+	fflush(stderr);
+	job->pid = fork();
+	if (job->pid < 0)
+		die("error: cannot fork");
+	if (job->pid == 0) {
+		dup2(fileno(job->out), STDOUT_FILENO);
+		dup2(fileno(job->err), STDERR_FILENO);
+		check_symbols(sparse(file));
+		// the counters are only meaningful here
+		report_stats();
+		exit(0);
+	}
+}
+
+static void check_files_parallel(struct string_list *filelist)
+{
+	int nr = ptr_list_size((struct ptr_list *)filelist);
+	struct job *jobs = calloc(nr, sizeof(*jobs));
+	int next = 0, running = 0, flushed = 0;
+	char **files = calloc(nr, sizeof(*files));
+	char *file;
+	int i = 0;
+
+	if (!jobs || !files)
+		die("out of memory");
+	FOR_EACH_PTR(filelist, file) {
+		files[i++] = file;
+	} END_FOR_EACH_PTR(file);
+
+	while (flushed < nr) {
+		int status;
+		pid_t pid;
+
+		while (running < parallel_jobs && next < nr) {
+			start_job(&jobs[next], files[next]);
+			next++;
+			running++;
+		}
+
+		pid = wait(&status);
+		if (pid < 0)
+			die("error: wait failed");
+		for (i = flushed; i < next; i++) {
+			if (jobs[i].pid != pid)
+				continue;
+			jobs[i].status = status;
+			jobs[i].done = 1;
+			running--;
+			break;
+		}
+
+		// output what can be, in order
+		for (; flushed < nr && jobs[flushed].done; flushed++) {
+			struct job *job = &jobs[flushed];
+			int code = 0;
+
+			copy_output(job->out, stdout);
+			fflush(stdout);
+			copy_output(job->err, stderr);
+			if (WIFEXITED(job->status))
+				code = WEXITSTATUS(job->status);
+			else if (WIFSIGNALED(job->status))
+				code = 128 + WTERMSIG(job->status);
+			if (!code)
+				continue;
+
+			// like the sequential case: stop at the first failure
+			for (i = flushed + 1; i < next; i++) {
+				if (!jobs[i].done)
+					kill(jobs[i].pid, SIGTERM);
+			}
+			while (wait(NULL) > 0)
+				;
+			exit(code);
+		}
+	}
+	free(files);
+	free(jobs);
+}
+
 int main(int argc, char **argv)
 {
 	struct string_list *filelist = NULL;
@@ -328,6 +460,10 @@ int main(int argc, char **argv)
 
 	// Expand, linearize and show it.
 	check_symbols(sparse_initialize(argc, argv, &filelist));
+	if (parallel_jobs > 1 && ptr_list_size((struct ptr_list *)filelist) > 1) {
+		check_files_parallel(filelist);
+		return 0;
+	}
 	FOR_EACH_PTR(filelist, file) {
 		check_symbols(sparse(file));
 	} END_FOR_EACH_PTR(file);
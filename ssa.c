@@ -398,4 +398,5 @@ void ssa_convert(struct entrypoint *ep)
 
 	// remove now dead stores
 	remove_dead_stores(stores);
+	free_ptr_list(&stores);
 }
@@ -1,9 +1,18 @@
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "allocate.h"
 #include "linearize.h"
+#include "inliner.h"
+#include "summary.h"
+#include "optimize.h"
 #include "storage.h"
+#include "token.h"
 
-__DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist64);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist128);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist256);
+__DECLARE_ALLOCATOR(struct ptr_list, ptrlist512);
 
 
 typedef void (*get_t)(struct allocator_stats*);
@@ -16,12 +25,17 @@ static void show_stats(get_t get, struct allocator_stats * tot)
 		get(&x);
 	else
 		x = *tot;
-	fprintf(stderr, "%16s: %8d, %10ld, %10ld, %6.2f%%, %8.2f\n",
+	fprintf(stderr, "%16s: %8d, %10ld, %10ld, %6.2f%%, %8.2f, %6d, %8ld, %5d, %5d\n",
 		x.name, x.allocations, x.useful_bytes, x.total_bytes,
 		100 * (double) x.useful_bytes / (x.total_bytes ? : 1),
-		(double) x.useful_bytes / (x.allocations ? : 1));
+		(double) x.useful_bytes / (x.allocations ? : 1),
+		x.nr_blobs, x.total_bytes / (x.nr_blobs ? : 1) / 1024,
+		x.huge_blobs, x.big_allocs);
 
 	tot->allocations += x.allocations;
+	tot->nr_blobs += x.nr_blobs;
+	tot->huge_blobs += x.huge_blobs;
+	tot->big_allocs += x.big_allocs;
 	tot->useful_bytes += x.useful_bytes;
 	tot->total_bytes += x.total_bytes;
 }
@@ -30,8 +44,9 @@ void show_allocation_stats(void)
 {
 	struct allocator_stats tot = { .name = "total", };
 
-	fprintf(stderr, "%16s: %8s, %10s, %10s, %7s, %8s\n", "allocator", "allocs",
-		"bytes", "total", "%usage", "average");
+	fprintf(stderr, "%16s: %8s, %10s, %10s, %7s, %8s, %6s, %8s, %5s, %5s\n",
+		"allocator", "allocs", "bytes", "total", "%usage", "average",
+		"blobs", "KB/blob", "huge", "big");
 	show_stats(get_token_stats, &tot);
 	show_stats(get_ident_stats, &tot);
 	show_stats(get_symbol_stats, &tot);
@@ -42,7 +57,10 @@ void show_allocation_stats(void)
 	show_stats(get_instruction_stats, &tot);
 	show_stats(get_pseudo_stats, &tot);
 	show_stats(get_pseudo_user_stats, &tot);
-	show_stats(get_ptrlist_stats, &tot);
+	show_stats(get_ptrlist64_stats, &tot);
+	show_stats(get_ptrlist128_stats, &tot);
+	show_stats(get_ptrlist256_stats, &tot);
+	show_stats(get_ptrlist512_stats, &tot);
 	show_stats(get_multijmp_stats, &tot);
 	show_stats(get_asm_rules_stats, &tot);
 	show_stats(get_asm_constraint_stats, &tot);
@@ -55,8 +73,183 @@ void show_allocation_stats(void)
 	show_stats(NULL, &tot);
 }
 
+////////////////////////////////////////////////////////////////////////
+// Timers
+
+struct timer_stats {
+	const char *name;
+	unsigned int calls;
+	double wall, cpu;
+};
+
+static struct timer_stats timers[TIMER_NR] = {
+	[TIMER_TOKENIZE]	= { "tokenize" },
+	[TIMER_PREPROCESS]	= { "preprocess" },
+	[TIMER_PARSE]		= { "parse" },
+	[TIMER_EVALUATE]	= { "evaluate" },
+	[TIMER_EXPAND]		= { "expand" },
+	[TIMER_LINEARIZE]	= { "linearize" },
+	[TIMER_INLINE]		= { "inline" },
+	[TIMER_CFG]		= { "cfg" },
+	[TIMER_SSA]		= { "ssa" },
+	[TIMER_SCCP]		= { "sccp" },
+	[TIMER_DCE]		= { "dce" },
+	[TIMER_MEMOPS]		= { "memops" },
+	[TIMER_SIMPLIFY]	= { "simplify" },
+	[TIMER_CSE]		= { "cse" },
+	[TIMER_LIVENESS]	= { "liveness" },
+	[TIMER_CHECK]		= { "check" },
+};
+
+static enum timer timer_stack[64];
+static int timer_depth, timer_overflow;
+static double timer_wall, timer_cpu;
+
+static double get_time(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// account the time elapsed since the last event to the current timer
+static void update_timer(void)
+{
+	double wall = get_time(CLOCK_MONOTONIC);
+	double cpu = get_time(CLOCK_PROCESS_CPUTIME_ID);
+
+	if (timer_depth) {
+		struct timer_stats *t = &timers[timer_stack[timer_depth - 1]];
+		t->wall += wall - timer_wall;
+		t->cpu += cpu - timer_cpu;
+	}
+	timer_wall = wall;
+	timer_cpu = cpu;
+}
+
+void __start_timer(enum timer timer)
+{
+	update_timer();
+	timers[timer].calls++;
+	if (timer_depth < ARRAY_SIZE(timer_stack))
+		timer_stack[timer_depth++] = timer;
+	else
+		timer_overflow++;
+}
+
+void __stop_timer(enum timer timer)
+{
+	update_timer();
+	if (timer_overflow)
+		timer_overflow--;
+	else if (timer_depth)
+		timer_depth--;
+}
+
+struct function_time {
+	struct ident *ident;
+	struct position pos;
+	double wall;
+	unsigned long visits;		// instructions visited by the simplifier
+};
+
+static struct function_time *slowest;
+static unsigned int slowest_nr;
+static double function_start;
+static unsigned long function_visits;
+
+void start_function_timer(void)
+{
+	if (!ftime_report || !ftime_report_functions)
+		return;
+	function_start = get_time(CLOCK_MONOTONIC);
+	function_visits = simplify_visits;
+}
+
+///
+// record the time spent on a function, if among the slowest ones
+void stop_function_timer(struct symbol *sym)
+{
+	unsigned int max = ftime_report_functions;
+	double wall;
+	int i;
+
+	if (!ftime_report || !max)
+		return;
+	wall = get_time(CLOCK_MONOTONIC) - function_start;
+	if (!slowest) {
+		slowest = calloc(max, sizeof(*slowest));
+		if (!slowest)
+			die("out of memory");
+	}
+	if (slowest_nr == max && wall <= slowest[max - 1].wall)
+		return;
+
+	// keep them sorted, the slowest first
+	if (slowest_nr < max)
+		slowest_nr++;
+	for (i = slowest_nr - 1; i > 0 && slowest[i - 1].wall < wall; i--)
+		slowest[i] = slowest[i - 1];
+	slowest[i].ident = sym->ident;
+	slowest[i].pos = sym->pos;
+	slowest[i].wall = wall;
+	slowest[i].visits = simplify_visits - function_visits;
+}
+
+static void show_time_stats(void)
+{
+	double wall = 0, cpu = 0;
+	unsigned int calls = 0;
+	int i;
+
+	update_timer();
+	for (i = 0; i < TIMER_NR; i++) {
+		calls += timers[i].calls;
+		wall += timers[i].wall;
+		cpu += timers[i].cpu;
+	}
+
+	fprintf(stderr, "%16s: %8s, %10s, %10s, %7s\n", "phase", "calls",
+		"wall (ms)", "cpu (ms)", "%wall");
+	for (i = 0; i < TIMER_NR; i++) {
+		struct timer_stats *t = &timers[i];
+
+		fprintf(stderr, "%16s: %8u, %10.3f, %10.3f, %6.2f%%\n",
+			t->name, t->calls, t->wall * 1e3, t->cpu * 1e3,
+			100 * t->wall / (wall ? : 1));
+	}
+	fprintf(stderr, "%16s: %8u, %10.3f, %10.3f, %6.2f%%\n", "total", calls,
+		wall * 1e3, cpu * 1e3, 100.0);
+	fprintf(stderr, "instructions visited by the simplifier: %lu\n", simplify_visits);
+	fprintf(stderr, "instructions in the optimized IR: %lu\n", optimized_insns);
+	fprintf(stderr, "calls in the optimized IR: %lu (%lu inlined)\n",
+		optimized_calls, inlined_calls);
+	fprintf(stderr, "function summaries: %lu (%lu from the cache)\n",
+		summarized_functions, cached_summaries);
+
+	if (!slowest_nr)
+		return;
+	fprintf(stderr, "slowest functions:\n");
+	for (i = 0; i < slowest_nr; i++) {
+		struct function_time *f = &slowest[i];
+
+		fprintf(stderr, "%10.3f ms %8lu visits  %s:%d: %s\n",
+			f->wall * 1e3, f->visits,
+			stream_name(f->pos.stream), f->pos.line,
+			show_ident(f->ident));
+	}
+}
+
 void report_stats(void)
 {
-	if (fmem_report)
+	if (fmem_report) {
 		show_allocation_stats();
+		show_include_stats();
+		show_identifier_stats();
+		fprintf(stderr, "value pseudos: %lu hits, %lu misses\n",
+			value_pseudo_hits, value_pseudo_misses);
+	}
+	if (ftime_report)
+		show_time_stats();
 }
@@ -0,0 +1,725 @@
+// SPDX-License-Identifier: MIT
+//
+// Summaries of the functions, for their callers
+//
+// Once linearized and optimized, each function is summarized: does it
+// read or write some memory other than its own local variables, has it
+// any side effect at all, can it return, does its context change in
+// a known way and which of its arguments may escape. The callers
+// linearized later then use these summaries instead of considering
+// every call as an opaque barrier: loads can be forwarded across
+// calls which don't write memory, stores are only kept for the calls
+// which may read them and calls without side effects can be removed.
+//
+// Only functions defined before their callers have a summary and
+// a function calling itself is summarized without knowing what its
+// recursive calls do. The summaries are allocated independently of
+// the IR allocators.
+//
+// When enabled with '-fsummary-cache=DIR', the summaries of the
+// external functions are also saved in DIR, keyed on the function's
+// name and type, and used for the calls to external functions not
+// defined in the file being checked. Each cached summary refers to
+// the list of the files read to produce it, with their size and a
+// hash of their content, and is only used while all these files are
+// unchanged. It may still come from another function with the same
+// name and type, so only what can't change the CFG of the caller is
+// used from the cache: a call is never considered as pure or as not
+// returning because of a cached summary.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "summary.h"
+#include "lib.h"
+#include "linearize.h"
+#include "symbol.h"
+#include "token.h"
+
+unsigned long summarized_functions, cached_summaries;
+
+// what is known about a function without summary
+static const struct fn_summary unknown_summary = {
+	.reads = 1,
+	.writes = 1,
+	.escapes = ~0ULL,
+};
+
+// max number of instructions followed when checking if an argument escapes
+#define ESCAPE_DEPTH	8
+
+static struct fn_summary *alloc_summary(void)
+{
+	struct fn_summary *s = calloc(1, sizeof(*s));
+
+	if (!s)
+		die("out of memory for the summaries");
+	return s;
+}
+
+////////////////////////////////////////////////////////////////////////
+// The on-disk cache
+
+#define SUMMARY_MAGIC	0x53505346	// "SPSF"
+#define SUMMARY_VERSION	3
+
+struct cache_summary {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nr_args;
+	uint32_t flags;
+	int32_t context;
+	uint32_t unused;
+	uint64_t escapes;
+	uint64_t signature;	// hash of the function's type
+	uint64_t deps;		// the list of the files it depends on
+};
+
+#define CACHE_READS	(1 << 0)
+#define CACHE_WRITES	(1 << 1)
+#define CACHE_CONTEXT	(1 << 2)
+
+#define HASH_INIT	0xcbf29ce484222325ULL
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, unsigned long size)
+{
+	const unsigned char *p = data;
+
+	// FNV-1a
+	while (size--)
+		hash = (hash ^ *p++) * 0x100000001b3ULL;
+	return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+	// the final null included
+	return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+// hash of the types of the return value and of the arguments
+static uint64_t type_signature(struct symbol *sym)
+{
+	struct symbol *type = sym->ctype.base_type;
+	uint64_t hash = HASH_INIT;
+	struct symbol *arg;
+
+	hash = hash_string(hash, show_typename(type->ctype.base_type));
+	FOR_EACH_PTR(type->arguments, arg) {
+		hash = hash_string(hash, show_typename(arg->ctype.base_type));
+	} END_FOR_EACH_PTR(arg);
+	return hash;
+}
+
+static bool cache_path(char *path, struct symbol *sym)
+{
+	struct ident *ident = sym->ident;
+	int n;
+
+	if (!ident)
+		return false;
+	n = snprintf(path, PATH_MAX, "%s/%.*s.sum", fsummary_cache, ident->len, ident->name);
+	return n > 0 && n < PATH_MAX;
+}
+
+static bool cacheable(struct symbol *sym)
+{
+	unsigned long mod = sym->ctype.modifiers;
+
+	return !(mod & (MOD_STATIC | MOD_INLINE | MOD_GNU_INLINE));
+}
+
+// write a file of the cache at once, through a temporary file which
+// is then renamed: concurrent runs must only ever see complete files.
+static void write_cache_file(const char *path, const void *data, unsigned long size)
+{
+	char tmp[PATH_MAX + 16];
+	int fd, ok;
+
+	mkdir(fsummary_cache, 0777);
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		return;
+	ok = write(fd, data, size) == size;
+	if (close(fd) < 0)
+		ok = 0;
+	if (!ok || rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+// The files the summaries depend on.
+//
+// A run storing some summaries also stores the list of the files it
+// has read so far, one per line with the hash of its content, its size
+// and its real path. This list is stored in DIR/<hash of the list>.dep
+// and the summaries refer to it by this hash. A run loading a summary
+// checks once each of the lists and each of the files it meets.
+
+struct cache_file {
+	char *path;		// real path
+	uint64_t size;
+	uint64_t hash;		// of the content
+	bool missing;		// can't be read
+};
+
+static struct cache_file *cache_files;
+static unsigned int nr_cache_files;
+
+struct cache_deps {
+	uint64_t id;
+	bool valid;
+};
+
+static struct cache_deps *checked_deps;
+static unsigned int nr_checked_deps;
+
+// make room for one more entry in an array of nr entries
+static void *grow(void *array, unsigned int nr, size_t size)
+{
+	// the arrays are doubled each time they are full
+	if (nr & (nr - 1))
+		return array;
+	array = realloc(array, (nr ? 2 * nr : 1) * size);
+	if (!array)
+		die("out of memory for the summaries");
+	return array;
+}
+
+// the size and the content's hash of a file, computed once per run
+static const struct cache_file *cache_file(const char *path)
+{
+	struct cache_file *f;
+	struct stat st;
+	unsigned int i;
+	void *buf;
+	int fd;
+
+	for (i = 0; i < nr_cache_files; i++) {
+		if (!strcmp(cache_files[i].path, path))
+			return &cache_files[i];
+	}
+	cache_files = grow(cache_files, nr_cache_files, sizeof(*f));
+	f = &cache_files[nr_cache_files++];
+	f->path = strdup(path);
+	f->size = 0;
+	f->hash = HASH_INIT;
+	f->missing = true;
+	if (!f->path)
+		die("out of memory for the summaries");
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return f;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		f->size = st.st_size;
+		if (!st.st_size) {
+			f->missing = false;
+		} else if ((buf = file_map(fd, st.st_size))) {
+			f->hash = hash_bytes(f->hash, buf, st.st_size);
+			f->missing = false;
+			file_unmap(buf, st.st_size);
+		}
+	}
+	close(fd);
+	return f;
+}
+
+///
+// store the list of the files read so far
+// @return: the id of the list or 0 if one of the files can't be read
+static uint64_t store_deps(void)
+{
+	static int nr_streams = -1;
+	static uint64_t id;
+	char line[PATH_MAX + 64];
+	char *buf = NULL;
+	size_t len = 0;
+	int i;
+
+	// the list only changes when some file is included
+	if (nr_streams == input_stream_nr)
+		return id;
+	nr_streams = input_stream_nr;
+	id = 0;
+
+	for (i = 0; i < input_stream_nr; i++) {
+		const char *name = input_streams[i].name;
+		const struct cache_file *f;
+		char path[PATH_MAX];
+		struct stat st;
+		int n;
+
+		// builtin & command-line streams
+		if (stat(name, &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+		if (!realpath(name, path))
+			goto out;
+		f = cache_file(path);
+		if (f->missing)
+			goto out;
+		n = snprintf(line, sizeof(line), "%016llx %llu %s\n",
+			(unsigned long long)f->hash, (unsigned long long)f->size, f->path);
+		buf = realloc(buf, len + n);
+		if (!buf)
+			die("out of memory for the summaries");
+		memcpy(buf + len, line, n);
+		len += n;
+	}
+	if (!len)
+		goto out;
+	id = hash_bytes(HASH_INIT, buf, len) | 1;
+	snprintf(line, sizeof(line), "%s/%016llx.dep", fsummary_cache, (unsigned long long)id);
+	if (access(line, F_OK) < 0)
+		write_cache_file(line, buf, len);
+out:
+	free(buf);
+	return id;
+}
+
+///
+// check if all the files of a list are unchanged, once per run
+static bool valid_deps(uint64_t id)
+{
+	struct cache_deps *deps;
+	char path[PATH_MAX];
+	unsigned int i;
+	char *line = NULL;
+	size_t size = 0;
+	FILE *in;
+	int n = 0;
+
+	for (i = 0; i < nr_checked_deps; i++) {
+		if (checked_deps[i].id == id)
+			return checked_deps[i].valid;
+	}
+	checked_deps = grow(checked_deps, nr_checked_deps, sizeof(*deps));
+	deps = &checked_deps[nr_checked_deps++];
+	deps->id = id;
+	deps->valid = false;
+
+	snprintf(path, sizeof(path), "%s/%016llx.dep", fsummary_cache, (unsigned long long)id);
+	in = fopen(path, "r");
+	if (!in)
+		return false;
+	while (getline(&line, &size, in) > 0) {
+		unsigned long long hash, len;
+		const struct cache_file *f;
+		int pos = 0;
+
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%llx %llu %n", &hash, &len, &pos) != 2 || !pos)
+			goto out;
+		f = cache_file(line + pos);
+		if (f->missing || f->size != len || f->hash != hash)
+			goto out;
+		n++;
+	}
+	deps->valid = n > 0;
+out:
+	free(line);
+	fclose(in);
+	return deps->valid;
+}
+
+static struct fn_summary *load_summary(struct symbol *sym, unsigned int nr_args)
+{
+	struct cache_summary c;
+	struct fn_summary *s;
+	char path[PATH_MAX];
+	int fd, n;
+
+	if (!cache_path(path, sym))
+		return NULL;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	n = read(fd, &c, sizeof(c));
+	close(fd);
+	if (n != sizeof(c))
+		return NULL;
+	if (c.magic != SUMMARY_MAGIC || c.version != SUMMARY_VERSION)
+		return NULL;
+	if (c.nr_args != nr_args || c.signature != type_signature(sym))
+		return NULL;
+	if (!valid_deps(c.deps))
+		return NULL;
+
+	s = alloc_summary();
+	s->nr_args = c.nr_args;
+	s->reads = !!(c.flags & CACHE_READS);
+	s->writes = !!(c.flags & CACHE_WRITES);
+	s->has_context = !!(c.flags & CACHE_CONTEXT);
+	s->context = c.context;
+	s->escapes = c.escapes;
+	cached_summaries++;
+	return s;
+}
+
+static void store_summary(struct symbol *sym, const struct fn_summary *s)
+{
+	struct cache_summary c = {
+		.magic = SUMMARY_MAGIC,
+		.version = SUMMARY_VERSION,
+		.nr_args = s->nr_args,
+		.context = s->context,
+		.escapes = s->escapes,
+		.signature = type_signature(sym),
+		.deps = store_deps(),
+	};
+	char path[PATH_MAX];
+
+	if (!c.deps || !cache_path(path, sym))
+		return;
+	c.flags |= s->reads ? CACHE_READS : 0;
+	c.flags |= s->writes ? CACHE_WRITES : 0;
+	c.flags |= s->has_context ? CACHE_CONTEXT : 0;
+	write_cache_file(path, &c, sizeof(c));
+}
+
+////////////////////////////////////////////////////////////////////////
+// The summaries seen from the calls
+
+static struct symbol *call_symbol(struct instruction *call)
+{
+	pseudo_t func = call->func;
+	struct symbol *sym;
+
+	if (func->type != PSEUDO_SYM)
+		return NULL;
+	sym = func->sym;
+	if (sym->definition)
+		sym = sym->definition;
+	if (sym->type != SYM_NODE)
+		return NULL;
+	return sym;
+}
+
+///
+// get the summary of the function called by @call
+// @return: the summary or NULL if nothing is known about the function.
+const struct fn_summary *call_summary(struct instruction *call)
+{
+	struct symbol *sym = call_symbol(call);
+	struct symbol *type;
+
+	if (!sym || !fsummaries)
+		return NULL;
+	if (sym->summary)
+		return sym->summary != &unknown_summary ? sym->summary : NULL;
+
+	// not yet summarized or not from the cache
+	if (!fsummary_cache || sym->stmt || !cacheable(sym))
+		return NULL;
+	type = sym->ctype.base_type;
+	if (!type || type->type != SYM_FN || type->variadic)
+		return NULL;
+	sym->summary = load_summary(sym, symbol_list_size(type->arguments));
+	if (!sym->summary)
+		sym->summary = (struct fn_summary *)&unknown_summary;
+	return call_summary(call);
+}
+
+static bool declared_pure(struct instruction *call)
+{
+	struct symbol *fntype = first_symbol(call->fntypes);
+
+	return fntype && (fntype->ctype.modifiers & MOD_PURE);
+}
+
+bool call_reads_memory(struct instruction *call)
+{
+	const struct fn_summary *s = call_summary(call);
+
+	return s ? s->reads : true;
+}
+
+bool call_writes_memory(struct instruction *call)
+{
+	const struct fn_summary *s;
+
+	if (declared_pure(call))
+		return false;
+	s = call_summary(call);
+	return s ? s->writes : true;
+}
+
+///
+// can @call be removed if its result is unused?
+bool call_is_pure(struct instruction *call)
+{
+	const struct fn_summary *s;
+
+	if (declared_pure(call))
+		return true;
+	s = call_summary(call);
+	return s && s->pure;
+}
+
+bool call_noreturn(struct instruction *call)
+{
+	const struct fn_summary *s = call_summary(call);
+
+	return s && s->noreturn;
+}
+
+static int arg_index(struct instruction *call, pseudo_t *userp)
+{
+	pseudo_t arg;
+	int nr = 0;
+
+	FOR_EACH_PTR(call->arguments, arg) {
+		if (THIS_ADDRESS(arg) == userp)
+			return nr;
+		nr++;
+	} END_FOR_EACH_PTR(arg);
+	return -1;
+}
+
+///
+// may the value used by @call via @userp escape from it?
+bool call_operand_escapes(struct instruction *call, pseudo_t *userp)
+{
+	const struct fn_summary *s;
+	int nr;
+
+	if (userp == &call->func)
+		return false;
+	s = call_summary(call);
+	if (!s)
+		return true;
+	nr = arg_index(call, userp);
+	if (nr < 0 || nr >= s->nr_args || nr >= 64)
+		return true;
+	return (s->escapes >> nr) & 1;
+}
+
+///
+// the change of context done by @call, 0 if unknown
+int call_context(struct instruction *call)
+{
+	const struct fn_summary *s = call_summary(call);
+
+	return s && s->has_context ? s->context : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Summarizing a function
+
+static bool local_address(pseudo_t addr)
+{
+	if (addr->type != PSEUDO_SYM)
+		return false;
+	return !(addr->sym->ctype.modifiers & (MOD_STATIC | MOD_NONLOCAL));
+}
+
+static void summarize_insns(struct entrypoint *ep, struct fn_summary *s)
+{
+	struct basic_block *bb;
+	bool returns = false;
+
+	s->pure = 1;
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
+			switch (insn->opcode) {
+			case OP_LOAD:
+				if (!local_address(insn->src))
+					s->reads = 1;
+				if (insn->is_volatile)
+					s->pure = 0;
+				break;
+			case OP_STORE:
+				if (!local_address(insn->src)) {
+					s->writes = 1;
+					s->pure = 0;
+				}
+				break;
+			case OP_CALL:
+				if (call_reads_memory(insn))
+					s->reads = 1;
+				if (call_writes_memory(insn))
+					s->writes = 1;
+				if (!call_is_pure(insn))
+					s->pure = 0;
+				break;
+			case OP_ASM:
+				s->reads = 1;
+				s->writes = 1;
+				s->pure = 0;
+				break;
+			case OP_CONTEXT:
+				s->pure = 0;
+				break;
+			case OP_RET:
+				returns = true;
+				break;
+			}
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	if (!returns) {
+		s->noreturn = 1;
+		s->pure = 0;
+	}
+}
+
+///
+// may the value @p escape from the function?
+// It doesn't if it's only used as an address to load from or
+// to store to, compared or given to functions where it doesn't
+// escape, directly or after some pointer arithmetic.
+static bool may_escape(pseudo_t p, int depth)
+{
+	struct pseudo_user *pu;
+
+	FOR_EACH_PTR(p->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (!insn->bb)
+			continue;
+		switch (insn->opcode) {
+		case OP_LOAD:
+		case OP_BINCMP ... OP_BINCMP_END:
+		case OP_CBR:
+			continue;
+		case OP_STORE:
+			if (pu->userp == &insn->src)
+				continue;
+			return true;
+		case OP_CALL:
+			if (!call_operand_escapes(insn, pu->userp))
+				continue;
+			return true;
+		case OP_ADD: case OP_SUB:
+		case OP_PTRCAST: case OP_UTPTR: case OP_PTRTU:
+		case OP_SEL: case OP_PHISOURCE: case OP_PHI:
+		case OP_COPY:
+			if (depth >= ESCAPE_DEPTH)
+				return true;
+			if (may_escape(insn->target, depth + 1))
+				return true;
+			continue;
+		default:
+			return true;
+		}
+	} END_FOR_EACH_PTR(pu);
+	return false;
+}
+
+static void summarize_args(struct entrypoint *ep, struct fn_summary *s)
+{
+	pseudo_t arg;
+
+	s->escapes = 0;
+	FOR_EACH_PTR(ep->entry->arg_list, arg) {
+		int nr = arg->nr - 1;
+
+		if (nr >= 64)
+			continue;
+		if (may_escape(arg, 0))
+			s->escapes |= 1ULL << nr;
+	} END_FOR_EACH_PTR(arg);
+
+	// the unused arguments have no pseudo and don't escape
+	if (s->nr_args < 64)
+		s->escapes &= (1ULL << s->nr_args) - 1;
+}
+
+#define CONTEXT_UNSEEN	INT_MIN
+
+static int insn_context(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_CONTEXT:
+		return insn->check ? 0 : insn->increment;
+	case OP_CALL:
+		return call_context(insn);
+	default:
+		return 0;
+	}
+}
+
+///
+// walk the CFG with the context at the entry of each BB
+// @exit: the context at the returns, CONTEXT_UNSEEN if none seen yet
+// @return: false if the context isn't the same on all the paths.
+static bool context_walk(struct basic_block *bb, int entry, int *exit)
+{
+	struct basic_block *child;
+	struct instruction *insn;
+
+	if (bb->context != CONTEXT_UNSEEN)
+		return bb->context == entry;
+	bb->context = entry;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!insn->bb)
+			continue;
+		entry += insn_context(insn);
+		if (insn->opcode != OP_RET)
+			continue;
+		if (*exit != CONTEXT_UNSEEN && *exit != entry)
+			return false;
+		*exit = entry;
+	} END_FOR_EACH_PTR(insn);
+
+	FOR_EACH_PTR(bb->children, child) {
+		if (!context_walk(child, entry, exit))
+			return false;
+	} END_FOR_EACH_PTR(child);
+	return true;
+}
+
+static void summarize_context(struct entrypoint *ep, struct fn_summary *s)
+{
+	struct basic_block *bb;
+	int exit = CONTEXT_UNSEEN;
+
+	// the callers already use the annotation
+	if (ep->name->ctype.contexts)
+		return;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->context = CONTEXT_UNSEEN;
+	} END_FOR_EACH_PTR(bb);
+	if (context_walk(ep->entry->bb, 0, &exit) && exit != CONTEXT_UNSEEN) {
+		s->has_context = 1;
+		s->context = exit;
+	}
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->priv = NULL;
+	} END_FOR_EACH_PTR(bb);
+}
+
+void summarize_function(struct entrypoint *ep)
+{
+	struct symbol *sym = ep->name;
+	struct symbol *type = sym->ctype.base_type;
+	struct fn_summary *s;
+
+	if (!ep->entry || !type || type->type != SYM_FN)
+		return;
+
+	s = alloc_summary();
+	s->nr_args = symbol_list_size(type->arguments);
+	summarize_insns(ep, s);
+	summarize_args(ep, s);
+	summarize_context(ep, s);
+	if (type->variadic)
+		s->nr_args = 0;		// nothing is known about the arguments
+	sym->summary = s;
+	summarized_functions++;
+
+	if (fsummary_cache && cacheable(sym) && !type->variadic)
+		store_summary(sym, s);
+}
@@ -0,0 +1,35 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdbool.h>
+
+struct entrypoint;
+struct instruction;
+struct pseudo;
+
+///
+// what a function does, as seen by its callers
+struct fn_summary {
+	unsigned int nr_args;
+	unsigned int reads:1;		// may read some non-local memory
+	unsigned int writes:1;		// may write some non-local memory
+	unsigned int pure:1;		// no side effects, can be removed if unused
+	unsigned int noreturn:1;	// never returns
+	unsigned int has_context:1;	// the context delta is known
+	int context;			// the context delta, if known
+	unsigned long long escapes;	// bit N: the argument N+1 may escape
+};
+
+void summarize_function(struct entrypoint *ep);
+
+const struct fn_summary *call_summary(struct instruction *call);
+bool call_reads_memory(struct instruction *call);
+bool call_writes_memory(struct instruction *call);
+bool call_is_pure(struct instruction *call);
+bool call_noreturn(struct instruction *call);
+bool call_operand_escapes(struct instruction *call, struct pseudo **userp);
+int call_context(struct instruction *call);
+
+extern unsigned long summarized_functions, cached_summaries;
+
+#endif
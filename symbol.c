@@ -254,6 +254,165 @@ static struct symbol * examine_struct_union_type(struct symbol *sym, int advance
 	return sym;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Index of the members of structs and unions
+//
+// Each lookup of a member by name or by offset was a scan of the list
+// of members (and of the anonymous ones). For big structs, accessed a
+// lot, this is quite costly. So, an index is built for the struct at
+// its first lookup, once examined, with:
+// * a hash table giving for each name its member and its offset,
+//   the members of anonymous structs or unions being flattened;
+// * the direct members sorted on their offset.
+// The index is only kept once the struct is examined and, since a
+// struct can be looked up while its members are still parsed, it's
+// rebuilt if its last member is not the same anymore.
+
+struct member_slot {
+	struct ident *ident;
+	struct symbol *member;
+	int offset;
+};
+
+struct member_index {
+	struct symbol *last;		// the last member when built
+	unsigned int mask;		// of the hash table ::slots
+	unsigned int nr;		// the number of members in ::by_offset
+	struct member_slot *slots;
+	struct symbol **by_offset;
+};
+
+DECLARE_ALLOCATOR(member_index);
+ALLOCATOR(member_index, "member indexes");
+
+static int count_members(struct symbol *type, unsigned int *nr_direct)
+{
+	struct symbol *member;
+	int nr = 0;
+
+	FOR_EACH_PTR(type->symbol_list, member) {
+		struct symbol *base = member->ctype.base_type;
+
+		if (nr_direct)
+			(*nr_direct)++;
+		if (member->ident)
+			nr++;
+		else if (base && (base->type == SYM_STRUCT || base->type == SYM_UNION))
+			nr += count_members(base, NULL);
+	} END_FOR_EACH_PTR(member);
+	return nr;
+}
+
+static void index_members(struct member_index *index, struct symbol *type, int offset)
+{
+	struct symbol *member;
+
+	FOR_EACH_PTR(type->symbol_list, member) {
+		struct symbol *base = member->ctype.base_type;
+		struct member_slot *slot;
+		unsigned int i;
+
+		if (!member->ident) {
+			if (base && (base->type == SYM_STRUCT || base->type == SYM_UNION))
+				index_members(index, base, offset + member->offset);
+			continue;
+		}
+		for (i = member->ident->hash & index->mask; (slot = &index->slots[i])->ident; i = (i + 1) & index->mask) {
+			if (slot->ident == member->ident)
+				break;
+		}
+		if (slot->ident)	// the first one wins
+			continue;
+		slot->ident = member->ident;
+		slot->member = member;
+		slot->offset = offset + member->offset;
+	} END_FOR_EACH_PTR(member);
+}
+
+static struct member_index *get_member_index(struct symbol *type)
+{
+	struct member_index *index = type->member_index;
+	struct symbol *last = last_ptr_list((struct ptr_list *) type->symbol_list);
+	unsigned int nr_direct = 0, size = 8;
+	struct symbol *member;
+	int nr;
+
+	if (index && index->last == last)
+		return index;
+
+	nr = count_members(type, &nr_direct);
+	while (size < 2 * nr)
+		size *= 2;
+	index = __alloc_member_index(size * sizeof(struct member_slot) + nr_direct * sizeof(struct symbol *));
+	index->last = last;
+	index->mask = size - 1;
+	index->slots = (void *) (index + 1);
+	index->by_offset = (void *) (index->slots + size);
+	index_members(index, type, 0);
+	// the members are almost always in order: a (stable) insertion sort
+	FOR_EACH_PTR(type->symbol_list, member) {
+		unsigned int i = index->nr++;
+
+		while (i && index->by_offset[i - 1]->offset > member->offset) {
+			index->by_offset[i] = index->by_offset[i - 1];
+			i--;
+		}
+		index->by_offset[i] = member;
+	} END_FOR_EACH_PTR(member);
+	if (type->examined)	// otherwise the offsets are not yet known
+		type->member_index = index;
+	return index;
+}
+
+///
+// find a member of a struct or union by its name
+// @type: the struct or union, already examined
+// @offset: the offset of the member found, anonymous members included
+// @return: the member or NULL if not found.
+struct symbol *find_struct_member(struct symbol *type, struct ident *ident, int *offset)
+{
+	struct member_index *index;
+	struct member_slot *slot;
+	unsigned int i;
+
+	if (!type->symbol_list)
+		return NULL;
+	index = get_member_index(type);
+	for (i = ident->hash & index->mask; (slot = &index->slots[i])->ident; i = (i + 1) & index->mask) {
+		if (slot->ident == ident) {
+			*offset = slot->offset;
+			return slot->member;
+		}
+	}
+	return NULL;
+}
+
+///
+// find the first direct member of a struct or union at a given offset
+// @type: the struct or union, already examined
+// @return: the member or NULL if none is at this offset.
+struct symbol *find_member_at(struct symbol *type, int offset)
+{
+	struct member_index *index;
+	unsigned int lo = 0, hi;
+
+	if (!type->symbol_list)
+		return NULL;
+	index = get_member_index(type);
+	hi = index->nr;
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if ((int) index->by_offset[mid]->offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < index->nr && (int) index->by_offset[lo]->offset == offset)
+		return index->by_offset[lo];
+	return NULL;
+}
+
 static struct symbol *examine_base_type(struct symbol *sym)
 {
 	struct symbol *base_type;
@@ -797,10 +956,11 @@ struct symbol *create_symbol(int stream, const char *name, int type, int namespa
 				type, sym->type);
 
 	if (!sym) {
-		struct token *token = built_in_token(stream, ident);
+		// only a position is needed, no need to allocate a token for it
+		struct position pos = { .type = TOKEN_IDENT, .stream = stream };
 
-		sym = alloc_symbol(token->pos, type);
-		bind_symbol(sym, token->ident, namespace);
+		sym = alloc_symbol(pos, type);
+		bind_symbol(sym, ident, namespace);
 	}
 	return sym;
 }
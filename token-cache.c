@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: MIT
+//
+// On-disk cache for the token streams of included files.
+//
+// When enabled with '-ftoken-cache=DIR', the tokens produced for
+// each header are saved in DIR, keyed on the file's path, and reused
+// by later invocations as long as the size, the modification time
+// and a hash of the content are unchanged.
+//
+// The cache only holds what the tokenizer itself produces, before
+// any preprocessing, so it doesn't depend on the macros or on the
+// include paths in effect. Streams for which the tokenizer issued
+// some diagnostic, or could have with other warning options, are
+// never cached (the diagnostic would be lost).
+//
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "lib.h"
+#include "allocate.h"
+#include "token.h"
+
+#define CACHE_MAGIC	0x53505443	// "SPTC"
+#define CACHE_VERSION	1
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tabstop;
+	uint32_t pathlen;
+	uint64_t size;
+	int64_t mtime;
+	int64_t mtime_nsec;
+	uint64_t hash;
+	uint64_t nr_tokens;
+	// followed by the path and then the tokens
+};
+
+struct cache_token {
+	uint8_t type;
+	uint8_t newline:1,
+		whitespace:1;
+	uint16_t pos;
+	uint32_t line;
+	// followed by the type-dependent data
+};
+
+struct buffer {
+	unsigned char *data;
+	unsigned long size, alloc;
+};
+
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, unsigned long size)
+{
+	const unsigned char *p = data;
+
+	// FNV-1a
+	while (size--)
+		hash = (hash ^ *p++) * 0x100000001b3ULL;
+	return hash;
+}
+
+#define HASH_INIT	0xcbf29ce484222325ULL
+
+static const char *cache_path(const char *name)
+{
+	static char cwd[PATH_MAX];
+	uint64_t hash = HASH_INIT;
+
+	// relative names depend on the current directory
+	if (name[0] != '/') {
+		if (!cwd[0] && !getcwd(cwd, sizeof(cwd)))
+			return NULL;
+		hash = hash_bytes(hash, cwd, strlen(cwd) + 1);
+	}
+	hash = hash_bytes(hash, name, strlen(name));
+	return xasprintf("%s/%016llx.tok", ftoken_cache, (unsigned long long)hash);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Loading
+
+#define GET(p, end, type, var) 			\
+	do {					\
+		if ((end) - (p) < sizeof(type))	\
+			return NULL;		\
+		memcpy(&(var), (p), sizeof(type)); \
+		(p) += sizeof(type);		\
+	} while (0)
+
+static struct token *load_tokens(int stream, const unsigned char *p, const unsigned char *end, uint64_t nr, struct token **endtoken)
+{
+	struct token *begin = NULL, **where = &begin;
+	struct token *token = NULL;
+
+	while (nr--) {
+		struct cache_token ct;
+		uint32_t len32;
+		uint16_t len16;
+		uint8_t len8;
+
+		GET(p, end, struct cache_token, ct);
+		token = __alloc_token(0);
+		token->pos.type = ct.type;
+		token->pos.stream = stream;
+		token->pos.newline = ct.newline;
+		token->pos.whitespace = ct.whitespace;
+		token->pos.pos = ct.pos;
+		token->pos.line = ct.line;
+		token->pos.noexpand = 0;
+
+		switch (ct.type) {
+		case TOKEN_STREAMBEGIN:
+		case TOKEN_STREAMEND:
+			break;
+		case TOKEN_IDENT:
+			GET(p, end, uint8_t, len8);
+			if (end - p < len8 || !len8)
+				return NULL;
+			token->ident = hash_ident_name((const char *)p, len8);
+			p += len8;
+			break;
+		case TOKEN_NUMBER:
+			GET(p, end, uint16_t, len16);
+			if (end - p < len16 || !len16 || p[len16-1])
+				return NULL;
+			token->number = xmemdup(p, len16);
+			p += len16;
+			break;
+		case TOKEN_SPECIAL:
+			GET(p, end, uint16_t, len16);
+			token->special = len16;
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			if (end - p < 4)
+				return NULL;
+			memcpy(token->embedded, p, 4);
+			p += 4;
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			GET(p, end, uint32_t, len32);
+			if (end - p < len32 || !len32 || len32 > MAX_STRING + 1)
+				return NULL;
+			token->string = __alloc_string(len32);
+			token->string->length = len32;
+			memcpy(token->string->data, p, len32);
+			p += len32;
+			break;
+		default:
+			return NULL;
+		}
+		*where = token;
+		where = &token->next;
+	}
+
+	if (p != end || !begin || token_type(begin) != TOKEN_STREAMBEGIN)
+		return NULL;
+	if (token_type(token) != TOKEN_STREAMEND)
+		return NULL;
+
+	// same as what mark_eof() does
+	eof_token_entry.pos = token->pos;
+	token_type(&eof_token_entry) = TOKEN_EOF;
+	eof_token_entry.pos.newline = 1;
+	eof_token_entry.next = &eof_token_entry;
+	token->next = &eof_token_entry;
+
+	*endtoken = token;
+	return begin;
+}
+
+static struct token *load_cache(int stream, const char *path, const struct cache_header *key, const char *name, struct token **endtoken)
+{
+	struct cache_header hdr;
+	struct token *begin = NULL;
+	unsigned char *buf, *p, *end;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(hdr))
+		goto out;
+	buf = file_map(fd, st.st_size);
+	if (!buf)
+		goto out;
+
+	p = buf;
+	end = buf + st.st_size;
+	memcpy(&hdr, p, sizeof(hdr));
+	p += sizeof(hdr);
+	if (memcmp(&hdr, key, offsetof(struct cache_header, nr_tokens)))
+		goto unmap;
+	if (end - p < hdr.pathlen || memcmp(p, name, hdr.pathlen))
+		goto unmap;
+	p += hdr.pathlen;
+
+	begin = load_tokens(stream, p, end, hdr.nr_tokens, endtoken);
+
+unmap:
+	file_unmap(buf, st.st_size);
+out:
+	close(fd);
+	return begin;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Storing
+
+static void put(struct buffer *buf, const void *data, unsigned long size)
+{
+	if (buf->size + size > buf->alloc) {
+		unsigned long alloc = buf->alloc * 2 + size + 4096;
+		unsigned char *ptr = realloc(buf->data, alloc);
+		if (!ptr)
+			die("out of memory");
+		buf->data = ptr;
+		buf->alloc = alloc;
+	}
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+}
+
+static void put_token(struct buffer *buf, struct token *token)
+{
+	struct cache_token ct = {
+		.type = token_type(token),
+		.newline = token->pos.newline,
+		.whitespace = token->pos.whitespace,
+		.pos = token->pos.pos,
+		.line = token->pos.line,
+	};
+	uint32_t len32;
+	uint16_t len16;
+	uint8_t len8;
+
+	put(buf, &ct, sizeof(ct));
+	switch (token_type(token)) {
+	case TOKEN_IDENT:
+		len8 = token->ident->len;
+		put(buf, &len8, sizeof(len8));
+		put(buf, token->ident->name, len8);
+		break;
+	case TOKEN_NUMBER:
+		len16 = strlen(token->number) + 1;
+		put(buf, &len16, sizeof(len16));
+		put(buf, token->number, len16);
+		break;
+	case TOKEN_SPECIAL:
+		len16 = token->special;
+		put(buf, &len16, sizeof(len16));
+		break;
+	case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+	case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+		put(buf, token->embedded, 4);
+		break;
+	case TOKEN_CHAR:
+	case TOKEN_WIDE_CHAR:
+	case TOKEN_STRING:
+	case TOKEN_WIDE_STRING:
+		len32 = token->string->length;
+		put(buf, &len32, sizeof(len32));
+		put(buf, token->string->data, len32);
+		break;
+	default:
+		break;
+	}
+}
+
+static void store_cache(const char *path, struct cache_header *hdr, const char *name, struct token *begin, struct token *end)
+{
+	struct buffer buf = { };
+	struct token *token;
+	const char *tmp;
+	int fd, ok;
+
+	put(&buf, hdr, sizeof(*hdr));
+	put(&buf, name, hdr->pathlen);
+	for (token = begin; ; token = token->next) {
+		put_token(&buf, token);
+		hdr->nr_tokens++;
+		if (token == end)
+			break;
+	}
+	memcpy(buf.data, hdr, sizeof(*hdr));
+
+	// write to a temporary file and rename it, concurrent runs
+	// must only ever see complete cache files.
+	mkdir(ftoken_cache, 0777);
+	tmp = xasprintf("%s.%d", path, (int)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		goto out;
+	ok = write(fd, buf.data, buf.size) == buf.size;
+	if (close(fd) < 0)
+		ok = 0;
+	if (!ok || rename(tmp, path) < 0)
+		unlink(tmp);
+out:
+	free(buf.data);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+///
+// tokenize the file 'fd' for the stream 'stream', using the cache if possible
+// @return: the first token or NULL if the file could not be read.
+struct token *tokenize_cached(int stream, int fd, struct token **endtoken)
+{
+	const char *name = input_streams[stream].name;
+	struct cache_header key = { };
+	struct token *begin;
+	const char *path;
+	int diagnostics;
+	struct stat st;
+	void *buf;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return NULL;
+	path = cache_path(name);
+	if (!path)
+		return NULL;
+	if (st.st_size == 0)
+		return NULL;
+	buf = file_map(fd, st.st_size);
+	if (!buf)
+		return NULL;
+
+	key.magic = CACHE_MAGIC;
+	key.version = CACHE_VERSION;
+	key.tabstop = tabstop;
+	key.pathlen = strlen(name);
+	key.size = st.st_size;
+	key.mtime = st.st_mtim.tv_sec;
+	key.mtime_nsec = st.st_mtim.tv_nsec;
+	key.hash = hash_bytes(HASH_INIT, buf, st.st_size);
+
+	begin = load_cache(stream, path, &key, name, endtoken);
+	if (!begin) {
+		begin = tokenize_stream_buffer(stream, buf, st.st_size, endtoken, &diagnostics);
+		if (!diagnostics)
+			store_cache(path, &key, name, begin, *endtoken);
+	}
+	file_unmap(buf, st.st_size);
+	return begin;
+}
@@ -70,6 +70,7 @@ extern int *hash_stream(const char *name);
 struct ident {
 	struct ident *next;	/* Hash chain of identifiers */
 	struct symbol *symbols;	/* Pointer to semantic meaning list */
+	unsigned int hash;	/* Full hash of the name */
 	unsigned char len;	/* Length of identifier name */
 	unsigned char tainted:1,
 	              reserved:1,
@@ -219,6 +220,7 @@ extern int init_stream(const struct position *pos, const char *, int fd, const c
 extern int stream_prev(int stream);
 extern const char *stream_name(int stream);
 extern struct ident *hash_ident(struct ident *);
+extern struct ident *hash_ident_name(const char *, int);
 extern struct ident *built_in_ident(const char *);
 extern struct token *built_in_token(int, struct ident *);
 extern const char *show_special(int);
@@ -228,9 +230,13 @@ extern const char *show_token(const struct token *);
 extern const char *quote_token(const struct token *);
 extern struct token * tokenize(const struct position *pos, const char *, int, struct token *, const char **next_path);
 extern struct token * tokenize_buffer(void *, unsigned long, struct token **);
+extern struct token *tokenize_stream_buffer(int, void *, unsigned long, struct token **, int *);
+
+extern struct token *tokenize_cached(int stream, int fd, struct token **endtoken);
 
 extern void show_identifier_stats(void);
 extern struct token *preprocess(struct token *);
+extern void show_include_stats(void);
 
 static inline int match_op(struct token *token, unsigned int op)
 {
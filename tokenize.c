@@ -31,6 +31,8 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -50,6 +52,7 @@ typedef struct {
 	int fd, offset, size;
 	int pos, line, nr;
 	int newline, whitespace;
+	int diagnostics;
 	struct token **tokenlist;
 	struct token *token;
 	unsigned char *buffer;
@@ -85,6 +88,16 @@ static struct position stream_pos(stream_t *stream)
 	return pos;
 }
 
+/*
+ * Position to use for a diagnostic about the stream.
+ * Streams with diagnostics must not be put in the token cache.
+ */
+static struct position stream_diag_pos(stream_t *stream)
+{
+	stream->diagnostics++;
+	return stream_pos(stream);
+}
+
 const char *show_special(int val)
 {
 	static char buffer[4];
@@ -294,12 +307,16 @@ const char *quote_token(const struct token *token)
 }
 
 #define HASHED_INPUT_BITS (6)
-#define HASHED_INPUT (1 << HASHED_INPUT_BITS)
 #define HASH_PRIME 0x9e370001UL
 
-static int input_stream_hashes[HASHED_INPUT] = { [0 ... HASHED_INPUT-1] = -1 };
+/*
+ * Hash table of the streams, by name. It's grown as the
+ * number of streams increases to keep the chains short.
+ */
+static int *input_stream_hashes;
+static int input_stream_hash_bits;
 
-int *hash_stream(const char *name)
+static uint32_t hash_stream_name(const char *name)
 {
 	uint32_t hash = 0;
 	unsigned char c;
@@ -307,9 +324,36 @@ int *hash_stream(const char *name)
 	while ((c = *name++) != 0)
 		hash = (hash + (c << 4) + (c >> 4)) * 11;
 
-	hash *= HASH_PRIME;
-	hash >>= 32 - HASHED_INPUT_BITS;
-	return input_stream_hashes + hash;
+	return hash * HASH_PRIME;
+}
+
+int *hash_stream(const char *name)
+{
+	uint32_t hash = hash_stream_name(name);
+
+	if (!input_stream_hashes)
+		return NULL;
+	return input_stream_hashes + (hash >> (32 - input_stream_hash_bits));
+}
+
+static void resize_stream_hashes(int bits)
+{
+	int i, size = 1 << bits;
+
+	free(input_stream_hashes);
+	input_stream_hashes = malloc(size * sizeof(int));
+	if (!input_stream_hashes)
+		die("Unable to allocate more streams space");
+	input_stream_hash_bits = bits;
+	for (i = 0; i < size; i++)
+		input_stream_hashes[i] = -1;
+
+	// rehash in order, so that the most recent streams come first
+	for (i = 0; i < input_stream_nr; i++) {
+		int *hash = hash_stream(input_streams[i].name);
+		input_streams[i].next_stream = *hash;
+		*hash = i;
+	}
 }
 
 int init_stream(const struct position *pos, const char *name, int fd, const char **next_path)
@@ -324,6 +368,10 @@ int init_stream(const struct position *pos, const char *name, int fd, const char
 			die("Unable to allocate more streams space");
 		input_streams_allocated = newalloc;
 	}
+	if (!input_stream_hashes)
+		resize_stream_hashes(HASHED_INPUT_BITS);
+	else if (stream >= (1 << input_stream_hash_bits))
+		resize_stream_hashes(input_stream_hash_bits + 1);
 	current = input_streams + stream;
 	memset(current, 0, sizeof(*current));
 	current->name = name;
@@ -427,10 +475,14 @@ got_eof:
 		c = '\\';
 		goto out;
 	}
+	// the warning depends on -Wnewline-eof: don't cache the stream
+	// even when the warning is disabled
+	if (stream->pos)
+		stream->diagnostics++;
 	if (stream->pos & Wnewline_eof)
-		warning(stream_pos(stream), "no newline at end of file");
+		warning(stream_diag_pos(stream), "no newline at end of file");
 	else if (spliced)
-		warning(stream_pos(stream), "backslash-newline at end of file");
+		warning(stream_diag_pos(stream), "backslash-newline at end of file");
 	return EOF;
 }
 
@@ -532,6 +584,103 @@ static const char cclass[257] = {
 	['"' + 1] = Quote,
 };
 
+/*
+ * Fast scanning of the input buffer, bypassing nextchar().
+ *
+ * These only skip over 'plain' characters, those for which nextchar()
+ * would just increment the column, so line-splicing, '\r', tabs and
+ * newlines are always left to nextchar(). They return the number of
+ * leading bytes of p[0 .. n-1] belonging to the given class.
+ * When SSE2 is available, 16 bytes are classified at once.
+ */
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+#define in_range(x, lo, hi)	\
+	_mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8((lo) - 1)), \
+		      _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), x))
+
+static inline unsigned int mask_identifier(__m128i x)
+{
+	__m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+	__m128i m = in_range(lower, 'a', 'z');
+
+	m = _mm_or_si128(m, in_range(x, '0', '9'));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+	return _mm_movemask_epi8(m);
+}
+
+static inline unsigned int mask_spaces(__m128i x)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+}
+
+static inline unsigned int mask_comment(__m128i x)
+{
+	__m128i m;
+
+	m = _mm_cmpeq_epi8(x, _mm_set1_epi8('*'));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+	return ~_mm_movemask_epi8(m) & 0xffff;
+}
+
+#define SCAN_BLOCKS(p, n, i, mask)					\
+	for (; i + 16 <= n; i += 16) {					\
+		__m128i x = _mm_loadu_si128((const __m128i *)(p + i));	\
+		unsigned int m = mask(x);				\
+		if (m != 0xffff)					\
+			return i + __builtin_ctz(~m);			\
+	}
+#else
+#define SCAN_BLOCKS(p, n, i, mask)
+#endif
+
+static inline int is_comment_plain(int c)
+{
+	return c != '*' && c != '\n' && c != '\\' && c != '\r' && c != '\t';
+}
+
+static int scan_identifier(const unsigned char *p, int n)
+{
+	int i = 0;
+
+	SCAN_BLOCKS(p, n, i, mask_identifier)
+	while (i < n && (cclass[p[i] + 1] & (Letter | Digit)))
+		i++;
+	return i;
+}
+
+static int scan_spaces(const unsigned char *p, int n)
+{
+	int i = 0;
+
+	SCAN_BLOCKS(p, n, i, mask_spaces)
+	while (i < n && p[i] == ' ')
+		i++;
+	return i;
+}
+
+static int scan_comment(const unsigned char *p, int n)
+{
+	int i = 0;
+
+	SCAN_BLOCKS(p, n, i, mask_comment)
+	while (i < n && is_comment_plain(p[i]))
+		i++;
+	return i;
+}
+
+static inline void skip_plain(stream_t *stream, int (*scan)(const unsigned char *, int))
+{
+	int n = scan(stream->buffer + stream->offset, stream->size - stream->offset);
+
+	stream->offset += n;
+	stream->pos += n;
+}
+
 /*
  * pp-number:
  *	digit
@@ -568,7 +717,7 @@ static int get_one_number(int c, int next, stream_t *stream)
 	}
 
 	if (p == buffer_end) {
-		sparse_error(stream_pos(stream), "number token exceeds %td characters",
+		sparse_error(stream_diag_pos(stream), "number token exceeds %td characters",
 		      buffer_end - buffer);
 		// Pretend we saw just "1".
 		buffer[0] = '1';
@@ -599,19 +748,19 @@ static int eat_string(int next, stream_t *stream, enum token_type type)
 			buffer[len] = next;
 		len++;
 		if (next == '\n') {
-			warning(stream_pos(stream),
+			warning(stream_diag_pos(stream),
 				"missing terminating %c character", delim);
 			/* assume delimiter is lost */
 			break;
 		}
 		if (next == EOF) {
-			warning(stream_pos(stream),
+			warning(stream_diag_pos(stream),
 				"End of file in middle of string");
 			return next;
 		}
 		if (!escape) {
 			if (want_hex && !(cclass[next + 1] & Hex))
-				warning(stream_pos(stream),
+				warning(stream_diag_pos(stream),
 					"\\x used with no following hex digits");
 			want_hex = 0;
 			escape = next == '\\';
@@ -621,10 +770,10 @@ static int eat_string(int next, stream_t *stream, enum token_type type)
 		}
 	}
 	if (want_hex)
-		warning(stream_pos(stream),
+		warning(stream_diag_pos(stream),
 			"\\x used with no following hex digits");
 	if (len > MAX_STRING) {
-		warning(stream_pos(stream), "string too long (%d bytes, %d bytes max)", len, MAX_STRING);
+		warning(stream_diag_pos(stream), "string too long (%d bytes, %d bytes max)", len, MAX_STRING);
 		len = MAX_STRING;
 	}
 	if (delim == '\'' && len && len <= 4) {
@@ -650,6 +799,7 @@ static int drop_stream_eoln(stream_t *stream)
 {
 	drop_token(stream);
 	for (;;) {
+		skip_plain(stream, scan_comment);
 		switch (nextchar(stream)) {
 		case EOF:
 			return EOF;
@@ -670,9 +820,11 @@ static int drop_stream_comment(stream_t *stream)
 	for (;;) {
 		int curr = next;
 		if (curr == EOF) {
-			warning(stream_pos(stream), "End of file in the middle of a comment");
+			warning(stream_diag_pos(stream), "End of file in the middle of a comment");
 			return curr;
 		}
+		if (curr != '*')
+			skip_plain(stream, scan_comment);
 		next = nextchar(stream);
 		if (curr == '*' && next == '/')
 			break;
@@ -794,29 +946,31 @@ static int get_one_special(int c, stream_t *stream)
 	return next;
 }
 
+/*
+ * The identifiers are kept in a hash table which grows as needed
+ * to keep the chains short. The full hash is saved in each ident,
+ * so that the chains can be walked and the table can be resized
+ * without looking at the names.
+ */
 #define IDENT_HASH_BITS (13)
-#define IDENT_HASH_SIZE (1<<IDENT_HASH_BITS)
-#define IDENT_HASH_MASK (IDENT_HASH_SIZE-1)
 
-#define ident_hash_init(c)		(c)
-#define ident_hash_add(oldhash,c)	((oldhash)*11 + (c))
-#define ident_hash_end(hash)		((((hash) >> IDENT_HASH_BITS) + (hash)) & IDENT_HASH_MASK)
-
-static struct ident *hash_table[IDENT_HASH_SIZE];
+static struct ident **hash_table;
+static unsigned int hash_table_bits;
 static int ident_hit, ident_miss, idents;
 
 void show_identifier_stats(void)
 {
-	int i;
+	unsigned int i, size = 1U << hash_table_bits;
 	int distribution[100];
+	int longest = 0;
 
-	fprintf(stderr, "identifiers: %d hits, %d misses\n",
-		ident_hit, ident_miss);
+	fprintf(stderr, "identifiers: %d hits, %d misses, %d idents, %u buckets\n",
+		ident_hit, ident_miss, idents, size);
 
 	for (i = 0; i < 100; i++)
 		distribution[i] = 0;
 
-	for (i = 0; i < IDENT_HASH_SIZE; i++) {
+	for (i = 0; i < size; i++) {
 		struct ident * ident = hash_table[i];
 		int count = 0;
 
@@ -824,6 +978,8 @@ void show_identifier_stats(void)
 			count++;
 			ident = ident->next;
 		}
+		if (count > longest)
+			longest = count;
 		if (count > 99)
 			count = 99;
 		distribution[count]++;
@@ -833,6 +989,42 @@ void show_identifier_stats(void)
 		if (distribution[i])
 			fprintf(stderr, "%2d: %d buckets\n", i, distribution[i]);
 	}
+	fprintf(stderr, "longest chain: %d, average: %.2f\n", longest,
+		(double) idents / (size - distribution[0] ? : 1));
+}
+
+static void resize_hash_table(unsigned int bits)
+{
+	unsigned int i, size = 1U << bits;
+	unsigned int old_size = hash_table ? 1U << hash_table_bits : 0;
+	struct ident **table = calloc(size, sizeof(*table));
+
+	if (!table)
+		die("out of memory");
+	for (i = 0; i < old_size; i++) {
+		struct ident *ident = hash_table[i];
+
+		while (ident) {
+			struct ident *next = ident->next;
+			struct ident **p = &table[ident->hash & (size - 1)];
+
+			ident->next = *p;
+			*p = ident;
+			ident = next;
+		}
+	}
+	free(hash_table);
+	hash_table = table;
+	hash_table_bits = bits;
+}
+
+static struct ident **hash_bucket(unsigned int hash)
+{
+	if (!hash_table)
+		resize_hash_table(IDENT_HASH_BITS);
+	else if (idents >= (1 << hash_table_bits))
+		resize_hash_table(hash_table_bits + 1);
+	return &hash_table[hash & ((1U << hash_table_bits) - 1)];
 }
 
 static struct ident *alloc_ident(const char *name, int len)
@@ -845,33 +1037,37 @@ static struct ident *alloc_ident(const char *name, int len)
 	return ident;
 }
 
-static struct ident * insert_hash(struct ident *ident, unsigned long hash)
+static struct ident * insert_hash(struct ident *ident, unsigned int hash)
 {
-	ident->next = hash_table[hash];
-	hash_table[hash] = ident;
+	struct ident **p = hash_bucket(hash);
+
+	ident->hash = hash;
+	ident->next = *p;
+	*p = ident;
 	ident_miss++;
+	idents++;
 	return ident;
 }
 
-static struct ident *create_hashed_ident(const char *name, int len, unsigned long hash)
+static struct ident *create_hashed_ident(const char *name, int len, unsigned int hash)
 {
 	struct ident *ident;
 	struct ident **p;
 
-	p = &hash_table[hash];
+	p = hash_bucket(hash);
 	while ((ident = *p) != NULL) {
-		if (ident->len == (unsigned char) len) {
-			if (strncmp(name, ident->name, len) != 0)
+		if (ident->hash == hash && ident->len == (unsigned char) len) {
+			if (memcmp(name, ident->name, len) != 0)
 				goto next;
 
 			ident_hit++;
 			return ident;
 		}
 next:
-		//misses++;
 		p = &ident->next;
 	}
 	ident = alloc_ident(name, len);
+	ident->hash = hash;
 	*p = ident;
 	ident->next = NULL;
 	ident_miss++;
@@ -879,17 +1075,40 @@ next:
 	return ident;
 }
 
-static unsigned long hash_name(const char *name, int len)
+/*
+ * Hash the name, 8 bytes at a time, with a multiply-xorshift mix
+ * and a final avalanche. The names are short, so this is mostly
+ * one or two rounds.
+ */
+static inline uint64_t hash_mix(uint64_t hash, uint64_t v)
+{
+	hash = (hash ^ v) * 0x9e3779b97f4a7c15ULL;
+	return hash ^ (hash >> 32);
+}
+
+static unsigned int hash_name(const char *name, int len)
 {
-	unsigned long hash;
-	const unsigned char *p = (const unsigned char *)name;
+	uint64_t hash = len, v;
 
-	hash = ident_hash_init(*p++);
-	while (--len) {
-		unsigned int i = *p++;
-		hash = ident_hash_add(hash, i);
+	while (len >= 8) {
+		memcpy(&v, name, 8);
+		hash = hash_mix(hash, v);
+		name += 8;
+		len -= 8;
+	}
+	if (len) {
+		v = 0;
+		memcpy(&v, name, len);
+		hash = hash_mix(hash, v);
 	}
-	return ident_hash_end(hash);
+
+	// murmur3's finalizer
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
 }
 
 struct ident *hash_ident(struct ident *ident)
@@ -897,12 +1116,16 @@ struct ident *hash_ident(struct ident *ident)
 	return insert_hash(ident, hash_name(ident->name, ident->len));
 }
 
-struct ident *built_in_ident(const char *name)
+struct ident *hash_ident_name(const char *name, int len)
 {
-	int len = strlen(name);
 	return create_hashed_ident(name, len, hash_name(name, len));
 }
 
+struct ident *built_in_ident(const char *name)
+{
+	return hash_ident_name(name, strlen(name));
+}
+
 struct token *built_in_token(int stream, struct ident *ident)
 {
 	struct token *token;
@@ -918,20 +1141,29 @@ static int get_one_identifier(int c, stream_t *stream)
 {
 	struct token *token;
 	struct ident *ident;
-	unsigned long hash;
 	char buf[256];
 	int len = 1;
 	int next;
 
-	hash = ident_hash_init(c);
 	buf[0] = c;
+	if (stream->offset < stream->size) {
+		const unsigned char *p = stream->buffer + stream->offset;
+		int n = stream->size - stream->offset;
+
+		if (n > sizeof(buf) - 1)
+			n = sizeof(buf) - 1;
+		n = scan_identifier(p, n);
+		memcpy(buf + 1, p, n);
+		len += n;
+		stream->offset += n;
+		stream->pos += n;
+	}
 	for (;;) {
 		next = nextchar(stream);
 		if (!(cclass[next + 1] & (Letter | Digit)))
 			break;
 		if (len >= sizeof(buf))
 			break;
-		hash = ident_hash_add(hash, next);
 		buf[len] = next;
 		len++;
 	};
@@ -945,8 +1177,7 @@ static int get_one_identifier(int c, stream_t *stream)
 							TOKEN_WIDE_STRING);
 		}
 	}
-	hash = ident_hash_end(hash);
-	ident = create_hashed_ident(buf, len, hash);
+	ident = hash_ident_name(buf, len);
 
 	/* Pass it on.. */
 	token = stream->token;
@@ -976,6 +1207,7 @@ static struct token *setup_stream(stream_t *stream, int idx, int fd,
 	stream->newline = 1;
 	stream->whitespace = 0;
 	stream->pos = 0;
+	stream->diagnostics = 0;
 
 	stream->token = NULL;
 	stream->fd = fd;
@@ -1002,6 +1234,7 @@ static struct token *tokenize_stream(stream_t *stream)
 			continue;
 		}
 		stream->whitespace = 1;
+		skip_plain(stream, scan_spaces);
 		c = nextchar(stream);
 	}
 	return mark_eof(stream);
@@ -1017,6 +1250,41 @@ struct token * tokenize_buffer(void *buffer, unsigned long size, struct token **
 	return begin;
 }
 
+struct token *tokenize_stream_buffer(int idx, void *buffer, unsigned long size, struct token **endtoken, int *diagnostics)
+{
+	stream_t stream;
+	struct token *begin;
+
+	begin = setup_stream(&stream, idx, -1, buffer, size);
+	*endtoken = tokenize_stream(&stream);
+	*diagnostics = stream.diagnostics;
+	return begin;
+}
+
+/*
+ * Regular files are mapped as a whole: the lexer can then walk
+ * the file directly without any read() and copy.
+ */
+static struct token *tokenize_mapped(stream_t *stream, int idx, int fd, struct token **endtoken)
+{
+	struct token *begin;
+	struct stat st;
+	void *map;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return NULL;
+	if (st.st_size == 0 || st.st_size > INT_MAX)
+		return NULL;
+	map = file_map(fd, st.st_size);
+	if (!map)
+		return NULL;
+
+	begin = setup_stream(stream, idx, -1, map, st.st_size);
+	*endtoken = tokenize_stream(stream);
+	file_unmap(map, st.st_size);
+	return begin;
+}
+
 struct token * tokenize(const struct position *pos, const char *name, int fd, struct token *endtoken, const char **next_path)
 {
 	struct token *begin, *end;
@@ -1030,8 +1298,17 @@ struct token * tokenize(const struct position *pos, const char *name, int fd, st
 		return endtoken;
 	}
 
-	begin = setup_stream(&stream, idx, fd, buffer, 0);
-	end = tokenize_stream(&stream);
+	start_timer(TIMER_TOKENIZE);
+	begin = NULL;
+	if (ftoken_cache && pos)
+		begin = tokenize_cached(idx, fd, &end);
+	if (!begin)
+		begin = tokenize_mapped(&stream, idx, fd, &end);
+	if (!begin) {
+		begin = setup_stream(&stream, idx, fd, buffer, 0);
+		end = tokenize_stream(&stream);
+	}
+	stop_timer(TIMER_TOKENIZE);
 	if (endtoken)
 		end->next = endtoken;
 	return begin;
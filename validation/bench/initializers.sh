@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Benchmark of big static initializers.
+#
+# usage: initializers.sh [number of elements ...]
+#
+# For each size, a file with a const table of structures and a plain
+# int array is generated and checked with 'sparse -ftime-report
+# -fmem-report', first without reads of the tables, then with a few
+# constant reads of them.
+
+set -e
+
+cd "$(dirname "$0")"
+SPARSE=${SPARSE:-../../sparse}
+TMP=${TMPDIR:-/tmp}/sparse-bench-init.$$.c
+trap 'rm -f "$TMP"' EXIT
+
+gen()
+{
+	awk -v n="$1" -v reads="$2" 'BEGIN {
+		print "struct foo { int a; short b; struct { char c[2]; } s; };"
+		print "static const struct foo tbl[" n "] = {"
+		for (i = 0; i < n; i++)
+			printf "\t{ %d, %d, { { %d, %d } } },\n", i, i % 32768, i % 128, (i + 1) % 128
+		print "};"
+		print "static const int flat[" n "] = {"
+		for (i = n - 1; i >= 0; i--)
+			printf "\t[%d] = %d,\n", i, i
+		print "};"
+		print "int get(int i) { return tbl[i].a + flat[i]; }"
+		for (i = 0; i < reads; i++)
+			printf "int get%d(void) { return tbl[%d].s.c[1] + flat[%d]; }\n", i, int(i * n / reads), int(n - 1 - i * n / reads)
+	}'
+}
+
+for n in ${@:-100000 300000 1000000}; do
+	for reads in 0 16; do
+		gen "$n" "$reads" > "$TMP"
+		echo "== $n elements, $reads reads"
+		$SPARSE -Wno-decl -ftime-report -fmem-report "$TMP"
+	done
+done
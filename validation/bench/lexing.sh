@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Benchmark of the tokenizer.
+#
+# usage: lexing.sh [number of lines ...]
+#
+# For each size, a file made of comments, indented statements with
+# long identifiers, numbers and strings is generated, inside '#if 0'
+# so that only the tokenizer does some real work, and checked with
+# sparse. The file is also given to test-lexing, whose output is
+# discarded, to time the tokenizer alone.
+
+set -e
+
+cd "$(dirname "$0")"
+SPARSE=${SPARSE:-../../sparse}
+TEST_LEXING=${TEST_LEXING:-../../test-lexing}
+TMP=${TMPDIR:-/tmp}/sparse-bench-lex.$$.c
+trap 'rm -f "$TMP"' EXIT
+
+gen()
+{
+	awk -v n="$1" 'BEGIN {
+		print "#if 0"
+		for (i = 0; i < n; i += 8) {
+			print "/*"
+			printf " * Comment number %d, long enough to be worth a bulk scan.\n", i
+			print " */"
+			printf "static unsigned long some_identifier_%d = 0x%x;\n", i, i
+			print "int function_with_a_long_name(int argument)"
+			print "{"
+			printf "\t\treturn argument * %d + strlen(\"string %d\");\t// trailing comment\n", i, i
+			print "}"
+		}
+		print "#endif"
+	}'
+}
+
+for n in ${@:-100000 400000 1000000}; do
+	gen "$n" > "$TMP"
+	echo "== $n lines"
+	# in a subshell, the second line of 'times' is the command's alone
+	for cmd in "$SPARSE" "$TEST_LEXING"; do
+		echo "$(basename "$cmd"): user and system times, of the shell then of $(basename "$cmd")"
+		(
+			$cmd "$TMP" > /dev/null 2>&1
+			times
+		)
+	done
+done
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Benchmark of the pointer lists.
+#
+# usage: ptrlist.sh [number of functions ...]
+#
+# For each size, a file with functions made of a loop around a long
+# sequence of statements, thus with big basic blocks, is generated.
+# It is checked with 'sparse -fmem-report' for the memory used by the
+# lists, then given to test-linearize, whose output is discarded,
+# to time the linearization and the walks over the instructions.
+
+set -e
+
+cd "$(dirname "$0")"
+SPARSE=${SPARSE:-../../sparse}
+TEST_LINEARIZE=${TEST_LINEARIZE:-../../test-linearize}
+TMP=${TMPDIR:-/tmp}/sparse-bench-ptrlist.$$.c
+trap 'rm -f "$TMP"' EXIT
+
+gen()
+{
+	awk -v n="$1" 'BEGIN {
+		print "int g[64];"
+		for (f = 0; f < n; f++) {
+			printf "int fun%d(int a, int b, int *p)\n", f
+			print "{"
+			print "\tint i, r = 0;"
+			print "\tfor (i = 0; i < a; i++) {"
+			for (s = 0; s < 120; s++)
+				printf "\t\tr += g[(i + %d) & 63] * b + p[%d];\n", s, s % 8
+			print "\t}"
+			print "\treturn r;"
+			print "}"
+		}
+	}'
+}
+
+for n in ${@:-100 300}; do
+	gen "$n" > "$TMP"
+	echo "== $n functions"
+	$SPARSE -fmem-report "$TMP" 2>&1 | grep -e 'allocator:' -e 'ptr list' -e 'total:'
+	# in a subshell, the second line of 'times' is test-linearize's alone
+	echo "test-linearize: user and system times, of the shell then of test-linearize"
+	(
+		$TEST_LINEARIZE "$TMP" > /dev/null 2>&1
+		times
+	)
+done
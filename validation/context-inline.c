@@ -0,0 +1,46 @@
+static void a(void) __attribute__((context(0,1)))
+{
+	__context__(1);
+}
+
+static void r(void) __attribute__((context(1,0)))
+{
+	__context__(-1);
+}
+
+// helpers without annotation
+static void lock(void)
+{
+	a();
+}
+
+static void unlock(void)
+{
+	r();
+}
+
+static void good_helpers(void)
+{
+	lock();
+	unlock();
+}
+
+static void good_annotated(void) __attribute__((context(0,1)))
+{
+	lock();
+}
+
+static void warn_helpers(void)
+{
+	unlock();
+}
+
+/*
+ * check-name: context-inline
+ *
+ * check-error-start
+context-inline.c:12:13: warning: context imbalance in 'lock' - wrong count at exit
+context-inline.c:17:13: warning: context imbalance in 'unlock' - unexpected unlock
+context-inline.c:33:13: warning: context imbalance in 'warn_helpers' - unexpected unlock
+ * check-error-end
+ */
@@ -0,0 +1,53 @@
+static void a(void) __attribute__((context(0,1)))
+{
+	__context__(1);
+}
+
+static void r(void) __attribute__((context(1,0)))
+{
+	__context__(-1);
+}
+
+// helpers without annotation, too big to be inlined
+static void lock(int x)
+{
+	if (x)
+		a();
+	else
+		a();
+}
+
+static void unlock(int x)
+{
+	if (x)
+		r();
+	else
+		r();
+}
+
+static void good_helpers(int x)
+{
+	lock(x);
+	unlock(x);
+}
+
+static void good_annotated(int x) __attribute__((context(0,1)))
+{
+	lock(x);
+}
+
+static void warn_helpers(int x)
+{
+	unlock(x);
+}
+
+/*
+ * check-name: context-summary
+ * check-command: sparse -finline-disable $file
+ *
+ * check-error-start
+context-summary.c:14:9: warning: context imbalance in 'lock' - wrong count at exit
+context-summary.c:23:17: warning: context imbalance in 'unlock' - unexpected unlock
+context-summary.c:39:13: warning: context imbalance in 'warn_helpers' - unexpected unlock
+ * check-error-end
+ */
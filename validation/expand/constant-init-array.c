@@ -10,6 +10,6 @@ int test_array(int i)
  * check-command: test-linearize -Wno-decl -fdump-ir $file
  *
  * check-output-ignore
- * check-output-excludes: phisrc\\..*return.*\\$2
- * check-output-contains: load\\.
+ * check-output-contains: phisrc\\..*\\$2
+ * check-output-excludes: load\\.
  */
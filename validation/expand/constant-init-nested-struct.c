@@ -15,7 +15,6 @@ int foo(void)
 /*
  * check-name: constant-init-nested-struct
  * check-command: test-linearize -Wno-decl -fdump-ir $file
- * check-known-to-fail
  *
  * check-output-ignore
  * check-output-contains: phisrc\\..*\\$3
@@ -0,0 +1,57 @@
+struct p { int a, b; };
+struct q { int x; struct p p, q, r; };
+union u { int i; struct { short l, h; } s; };
+
+#define INIT {				\
+	.x = 1, .x = 2,			\
+	.p.b = 5, .p = { 1 },		\
+	.q = { 3, 4 }, .q.b = 6,	\
+	.r.a = 7, .r = { .b = 8 },	\
+}
+
+static const struct q ox = INIT;
+static const struct q opa = INIT;
+static const struct q opb = INIT;
+static const struct q oqa = INIT;
+static const struct q oqb = INIT;
+static const struct q ora = INIT;
+static const struct q orb = INIT;
+static const union u oi = { .i = 1, .s.h = 2 };
+static const union u oh = { .i = 1, .s.h = 2 };
+
+int x0(void) { return ox.x; }
+int pa0(void) { return opa.p.a; }
+int pb0(void) { return opb.p.b; }
+int qa0(void) { return oqa.q.a; }
+int qb0(void) { return oqb.q.b; }
+int ra0(void) { return ora.r.a; }
+int rb0(void) { return orb.r.b; }
+int i0(void) { return oi.i; }
+int h0(void) { return oh.s.h; }
+
+int x1(void) { return ox.x; }
+int pa1(void) { return opa.p.a; }
+int pb1(void) { return opb.p.b; }
+int qa1(void) { return oqa.q.a; }
+int qb1(void) { return oqb.q.b; }
+int ra1(void) { return ora.r.a; }
+int rb1(void) { return orb.r.b; }
+int i1(void) { return oi.i; }
+int h1(void) { return oh.s.h; }
+
+/*
+ * check-name: constant-init-override
+ * check-description: the values overridden by a nested list, or given
+ *	after it, and the values partially overridden are not trusted.
+ *	The first read of an object walks its initializer, the next ones
+ *	use its index.
+ * check-command: test-linearize -Wno-decl -Wno-override-init $file
+ *
+ * check-output-ignore
+ * check-output-pattern(2): ret\\.32 *\\$1$
+ * check-output-pattern(2): ret\\.32 *\\$2$
+ * check-output-pattern(2): ret\\.32 *\\$3$
+ * check-output-pattern(2): ret\\.32 *\\$8$
+ * check-output-pattern(10): load\\.
+ * check-output-excludes: ret\\.32 *\\$[4567]$
+ */
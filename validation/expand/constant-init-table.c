@@ -0,0 +1,66 @@
+struct e {
+	int a;
+	short b;
+	struct {
+		int c[2];
+	} s;
+};
+
+static const struct e tbl[4] = {
+	[0] = { 1, 2, { { 3, 4 } } },
+	[2] = { .b = 5, .s.c[1] = 6 },
+	[3].a = 7,
+};
+
+static struct e var[1] = { { 8, 9 } };
+
+struct p { int a, b; };
+static const int dup[3] = { [1] = 1, [1] = 7 };
+static const struct p dupsub[2] = { [0] = { 1, 2 }, [0].b = 5 };
+static const struct p over[2] = { [0].b = 5, [0] = { 1 } };
+static const int range[4] = { [1] = 1, [0 ... 2] = 3 };
+const int weak __attribute__((weak)) = 9;
+const int weakarr[2] __attribute__((weak)) = { 9, 9 };
+
+int tbl0a(void) { return tbl[0].a; }
+int tbl0c(void) { return tbl[0].s.c[1]; }
+int tbl2b(void) { return tbl[2].b; }
+int tbl2c(void) { return tbl[2].s.c[1]; }
+int tbl2a(void) { return tbl[2].a; }
+int tbl1a(void) { return tbl[1].a; }
+int tbl3a(void) { return tbl[3].a; }
+int var0a(void) { return var[0].a; }
+int dup1(void) { return dup[1]; }
+int dupsub0b(void) { return dupsub[0].b; }
+int over0b(void) { return over[0].b; }
+int range1(void) { return range[1]; }
+int weak0(void) { return weak; }
+int weakarr1(void) { return weakarr[1]; }
+
+/*
+ * check-name: constant-init-table
+ * check-description: reads of const objects, even with their
+ *	address taken, but not of weak ones.
+ * check-command: test-linearize -Wno-decl $file
+ *
+ * check-output-ignore
+ * check-output-pattern(1): ret\\.32 *\\$1$
+ * check-output-pattern(1): ret\\.32 *\\$4$
+ * check-output-pattern(1): ret\\.32 *\\$5$
+ * check-output-pattern(1): ret\\.32 *\\$6$
+ * check-output-pattern(2): ret\\.32 *\\$0$
+ * check-output-pattern(2): ret\\.32 *\\$7$
+ * check-output-pattern(6): load\\.
+ * check-output-excludes: ret\\.32 *\\$9$
+ *
+ * check-error-start
+expand/constant-init-table.c:18:30: warning: Initializer entry defined twice
+expand/constant-init-table.c:18:39:   also defined here
+expand/constant-init-table.c:19:38: warning: Initializer entry defined twice
+expand/constant-init-table.c:19:54:   also defined here
+expand/constant-init-table.c:20:47: warning: Initializer entry defined twice
+expand/constant-init-table.c:20:36:   also defined here
+expand/constant-init-table.c:21:41: warning: Initializer entry defined twice
+expand/constant-init-table.c:21:32:   also defined here
+ * check-error-end
+ */
@@ -8,7 +8,6 @@ int test_array(int i)
 /*
  * check-name: default-init-array
  * check-command: test-linearize -Wno-decl -fdump-ir $file
- * check-known-to-fail
  *
  * check-output-ignore
  * check-output-contains: phisrc\\..*return.*\\$0
@@ -0,0 +1,122 @@
+struct big {
+	int m0;
+	int m1;
+	int m2;
+	int m3;
+	int m4;
+	int m5;
+	int m6;
+	int m7;
+	int m8;
+	int m9;
+	int m10;
+	int m11;
+	int m12;
+	int m13;
+	int m14;
+	int m15;
+	int m16;
+	int m17;
+	int m18;
+	int m19;
+	int m20;
+	int m21;
+	int m22;
+	int m23;
+	int m24;
+	int m25;
+	int m26;
+	int m27;
+	int m28;
+	int m29;
+	int m30;
+	int m31;
+	int m32;
+	int m33;
+	int m34;
+	int m35;
+	int m36;
+	int m37;
+	int m38;
+	int m39;
+	union {
+		int u;
+		struct {
+			char c;
+			int x;
+		};
+	};
+	int m0b;
+	struct {
+		int y;
+		int u;		// shadowed by the first 'u'
+	};
+};
+
+int get_x(struct big *p) { return p->x; }
+int get_y(struct big *p) { return p->y; }
+int get_u(struct big *p) { return p->u; }
+int get_m39(struct big *p) { return p->m39; }
+int get_bad(struct big *p) { return p->nope; }
+
+static struct big b = { .m1 = 1, .x = 2, .y = 3 };
+int get_bx(void) { return b.x; }
+int get_bm2(void) { return b.m2; }
+
+/*
+ * check-name: member-index
+ * check-command: test-linearize -Wno-decl $file
+ *
+ * check-error-start
+member-index.c:60:38: error: no member 'nope' in struct big
+ * check-error-end
+ *
+ * check-output-start
+get_x:
+.L0:
+	<entry-point>
+	load.32     %r2 <- 164[%arg1]
+	ret.32      %r2
+
+
+get_y:
+.L2:
+	<entry-point>
+	load.32     %r5 <- 172[%arg1]
+	ret.32      %r5
+
+
+get_u:
+.L4:
+	<entry-point>
+	load.32     %r8 <- 160[%arg1]
+	ret.32      %r8
+
+
+get_m39:
+.L6:
+	<entry-point>
+	load.32     %r11 <- 156[%arg1]
+	ret.32      %r11
+
+
+get_bad:
+.L8:
+	<entry-point>
+	ret.32
+
+
+get_bx:
+.L10:
+	<entry-point>
+	ret.32      $2
+
+
+get_bm2:
+.L12:
+	<entry-point>
+	ret.32      $0
+
+
+ * check-output-end
+ */
@@ -0,0 +1,20 @@
+void use(int);
+
+void foo(int n)
+{
+	int i, k = 0;
+
+	for (i = 0; i < n; i++) {
+		k += i;
+		use(i);
+	}
+}
+
+/*
+ * check-name: dce-phi-cycle
+ * check-command: test-linearize -Wno-decl $file
+ *
+ * check-output-ignore
+ * check-output-pattern(1): phi\\.
+ * check-output-pattern(1): add\\.
+ */
@@ -0,0 +1,57 @@
+int g(int);
+
+int foo(int a, int b)
+{
+	int k = 0, x = 0;
+
+	if (a)
+		x = g(1);
+	if (k)
+		x = g(x);
+	else if (b)
+		x = g(2);
+	while (a-- > 0) {
+		if (k)
+			continue;
+		x += g(a);
+	}
+	return x;
+}
+
+int bar(int a, int b)
+{
+	int x = 0;
+
+	if (a && b)
+		x = g(1);
+	if (a && b)
+		x = g(x);
+	switch (a ? 1 : 2) {
+	case 1:
+		x += g(3);
+	case 2:
+		return x;
+	}
+	return 0;
+}
+
+void baz(int p, volatile int *ptr)
+{
+	p ? : *ptr;
+	p ? : *ptr;
+}
+
+void qux(int a, int b)
+{
+	if (b)
+		while ((a += 5) > a)
+			;
+}
+
+/*
+ * check-name: domtree-update
+ * check-description: check the incremental update of the dominance tree
+ * check-command: test-linearize -Wno-decl -vdomtree-check $file
+ *
+ * check-output-ignore
+ */
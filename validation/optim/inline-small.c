@@ -0,0 +1,35 @@
+struct s {
+	int a, b;
+};
+
+static int get_a(struct s *s)
+{
+	return s->a;
+}
+
+static void set_b(struct s *s, int v)
+{
+	s->b = v;
+}
+
+static int max(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+int foo(struct s *s)
+{
+	set_b(s, 3);
+	return get_a(s) + s->b + max(get_a(s), 4);
+}
+
+/*
+ * check-name: inline-small
+ * check-command: test-linearize -Wno-decl $file
+ *
+ * check-output-ignore
+ * check-output-pattern(2): load\\.
+ * check-output-pattern(2): store\\.
+ * check-output-pattern(2): select\\.
+ * check-output-excludes: call
+ */
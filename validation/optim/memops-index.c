@@ -0,0 +1,53 @@
+#define R4(x)	x x x x
+#define R16(x)	R4(R4(x))
+#define R64(x)	R16(R4(x))
+
+extern int g[4], h, out[6];
+void ext(void);
+
+void big(int *p, int *q)
+{
+	int l;
+
+	g[0] = 1;
+	R64(h += p[0];)
+	out[0] = g[0];		// no aliasing store: 1
+
+	*q = 2;
+	R64(h += p[1];)
+	out[1] = g[0];		// may be changed via q: reloaded
+
+	g[1] = 3;
+	l = 4;
+	R64(h += p[2];)
+	ext();
+	R64(h += p[3];)
+	out[2] = g[1];		// may be changed by the call: reloaded
+	out[3] = l;		// local, not changed by the call: 4
+
+	g[2] = 5;
+	R64(h += p[4];)
+	__asm__("" ::: "memory");
+	g[3] = 6;
+	R64(h += p[5];)
+	out[4] = g[2];		// may be changed by the asm: reloaded
+	__asm__("" : : "r" (l));
+	R64(h += p[6];)
+	out[5] = g[3];		// no clobber: 6
+}
+
+/*
+ * check-name: memops-index
+ * check-description: the index of the accesses of a big BB must see
+ *	the same aliasing stores, calls and asm barriers as the walk.
+ * check-command: test-linearize -Wno-decl -vmemops-index $file
+ *
+ * check-output-ignore
+ * check-output-contains: store\\.32 *\\$1 -> 0\\[out\\]
+ * check-output-pattern(1): load\\.32 .* <- 0\\[g\\]
+ * check-output-contains: load\\.32 .* <- 4\\[g\\]
+ * check-output-contains: store\\.32 *\\$4 -> 12\\[out\\]
+ * check-output-contains: load\\.32 .* <- 8\\[g\\]
+ * check-output-contains: store\\.32 *\\$6 -> 20\\[out\\]
+ * check-output-excludes: load\\.32 .* <- 12\\[g\\]
+ */
@@ -7,7 +7,7 @@ void foo(int a[])
 
 /*
  * check-name: memops-missed02
- * check-command: test-linearize -Wno-decl $file
+ * check-command: test-linearize -Wno-decl -fdce-disable $file
  *
  * check-output-ignore
  * check-output-pattern(1): load\\.
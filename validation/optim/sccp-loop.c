@@ -0,0 +1,18 @@
+int foo(int n)
+{
+	int x = 1, i;
+
+	for (i = 0; i < n; i++) {
+		if (x != 1)
+			x = 2;
+	}
+	return x;
+}
+
+/*
+ * check-name: sccp-loop
+ * check-command: test-linearize -Wno-decl $file
+ *
+ * check-output-ignore
+ * check-output-returns: 1
+ */
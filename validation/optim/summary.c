@@ -0,0 +1,62 @@
+int g, h;
+
+static int get_h(void)
+{
+	int r = h;
+	if (r > 10)
+		r = 10;
+	return r;
+}
+
+static void set_h(int v)
+{
+	h = v;
+}
+
+static void stop(void)
+{
+	for (;;)
+		set_h(0);
+}
+
+int pure_unused(void)
+{
+	get_h();
+	return 0;
+}
+
+int load_across_read(void)
+{
+	int r;
+
+	g = 1;
+	r = get_h();
+	return g + r;
+}
+
+int store_across_write(void)
+{
+	g = 1;
+	set_h(2);
+	g = 3;
+	return 0;
+}
+
+int noreturn(int x)
+{
+	if (x)
+		stop();
+	return x;
+}
+
+/*
+ * check-name: summary
+ * check-command: test-linearize -Wno-decl -finline-disable $file
+ *
+ * check-output-ignore
+ * check-output-pattern(1): call\\.32 .*get_h
+ * check-output-pattern(1): load\\.
+ * check-output-pattern(3): store\\.
+ * check-output-contains: store\\.32 *\\$3 -> 0\\[g\\]
+ * check-output-contains: unreachable
+ */
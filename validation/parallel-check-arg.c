@@ -0,0 +1,11 @@
+/*
+ * check-name: parallel-check-arg
+ * check-description: only a number following '-j' is taken as its count,
+ *	here '2nd.c' must be taken as a file to check.
+ * check-command: sparse -j 2nd.c $file
+ * check-exit-value: 1
+ *
+ * check-error-start
+No such file: 2nd.c
+ * check-error-end
+ */
@@ -0,0 +1,15 @@
+static int foo(void)
+{
+	return 1 << 40;
+}
+
+/*
+ * check-name: parallel-check
+ * check-command: sparse -j2 $file $file $file
+ *
+ * check-error-start
+parallel-check.c:3:21: warning: shift too big (40) for type int
+parallel-check.c:3:21: warning: shift too big (40) for type int
+parallel-check.c:3:21: warning: shift too big (40) for type int
+ * check-error-end
+ */
@@ -0,0 +1,28 @@
+#ifdef DEFINE
+#include "cache-stale.c.output.h"
+#else
+void foo(void);
+
+int g;
+
+int main(void)
+{
+	g = 1;
+	foo();
+	return g;
+}
+#endif
+
+/*
+ * check-name: summary-cache-stale
+ * check-description: a cached summary must not be used once the file
+ *	defining the function has changed, even if it wasn't checked again.
+ * check-pre-command: sparse -E -DV=1 -o $file.output.h summary/cache-stale.h
+ * check-pre-command: test-linearize -Wno-decl -DDEFINE -fsummary-cache=$file.output.cache $file
+ * check-pre-command: sparse -E -DV=2 -o $file.output.h summary/cache-stale.h
+ * check-command: test-linearize -Wno-decl -fsummary-cache=$file.output.cache $file
+ *
+ * check-output-ignore
+ * check-output-contains: load\\.32 .* <- 0\\[g\\]
+ * check-output-excludes: ret\\.32 *\\$1
+ */
@@ -0,0 +1,6 @@
+
+extern int g;
+void foo(void)
+{
+			g = 5;
+}
@@ -0,0 +1,12 @@
+extern int g;
+
+#if V == 1
+void foo(void)
+{
+}
+#else
+void foo(void)
+{
+	g = 5;
+}
+#endif
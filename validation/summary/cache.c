@@ -0,0 +1,56 @@
+#ifdef DEFINE
+void stop(void)
+{
+	for (;;)
+		;
+}
+
+int nowrite(int a)
+{
+	return a;
+}
+
+int other(long a)
+{
+	return a;
+}
+#else
+void stop(void);
+int nowrite(int a);
+int other(int a);
+
+int g;
+
+int call_stop(void)
+{
+	stop();
+	return g;
+}
+
+int call_nowrite(void)
+{
+	g = 1;
+	nowrite(0);
+	return g;
+}
+
+int call_other(void)
+{
+	g = 2;
+	other(0);
+	return g;
+}
+#endif
+
+/*
+ * check-name: summary-cache
+ * check-description: a cached summary is only used for a function of
+ *	the same type and never makes a call pure or not returning.
+ * check-pre-command: test-linearize -Wno-decl -DDEFINE -fsummary-cache=$file.output.cache $file
+ * check-command: test-linearize -Wno-decl -fsummary-cache=$file.output.cache $file
+ *
+ * check-output-ignore
+ * check-output-excludes: unreachable
+ * check-output-contains: ret\\.32 *\\$1
+ * check-output-pattern(2): load\\.
+ */
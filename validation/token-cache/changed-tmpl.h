@@ -0,0 +1 @@
+static const int changed = V;
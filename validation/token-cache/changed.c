@@ -0,0 +1,16 @@
+#include "changed.c.output.h"
+
+/*
+ * check-name: token-cache-changed
+ * check-description: a header changed after being cached must be
+ *	tokenized again, even if its size is the same.
+ * check-pre-command: sparse -E -DV=1 -o $file.output.h token-cache/changed-tmpl.h
+ * check-pre-command: sparse -ftoken-cache=$file.output.cache $file
+ * check-pre-command: sparse -E -DV=2 -o $file.output.h token-cache/changed-tmpl.h
+ * check-command: sparse -E -ftoken-cache=$file.output.cache $file
+ *
+ * check-output-start
+
+static const int changed = 2;
+ * check-output-end
+ */
@@ -0,0 +1,2 @@
+
+static const int changed = 2;
@@ -0,0 +1,14 @@
+#include "newline-eof.h"
+
+/*
+ * check-name: token-cache-newline-eof
+ * check-description: a header cached by a run without -Wnewline-eof
+ *	must still give the warning in a run with it.
+ * check-pre-command: sparse -Wno-newline-eof -ftoken-cache=$file.output.cache $file
+ * check-command: sparse -Wnewline-eof -ftoken-cache=$file.output.cache $file
+ *
+ * check-error-start
+token-cache/newline-eof.c: note: in included file:
+token-cache/newline-eof.h:1:21: warning: no newline at end of file
+ * check-error-end
+ */
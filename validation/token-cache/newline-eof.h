@@ -0,0 +1 @@
+int newline_eof(int);
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "warm.h"
+
+int warm(void) { return warm_chr + warm_var; }
+
+/*
+ * check-name: token-cache-warm
+ * check-description: a run using the tokens cached by a previous
+ *	run must give the same output and the same diagnostics.
+ * check-pre-command: sparse -E -ftoken-cache=$file.output.cache $file
+ * check-command: sparse -E -ftoken-cache=$file.output.cache $file
+ *
+ * check-output-start
+
+static const char *warm_str = "warm header" "\t\"str\"";
+static const int warm_chr = 'w' + L'\x41' + 0x1fULL + 1.5e3f;
+static int warm_var = sizeof(warm_str);
+int warm(void) { return warm_chr + warm_var; }
+ * check-output-end
+ *
+ * check-error-start
+token-cache/warm.c: note: in included file:
+token-cache/warm.h:6:2: warning: "from the cached header"
+ * check-error-end
+ */
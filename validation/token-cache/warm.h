@@ -0,0 +1,7 @@
+#define STR(x)	#x
+#define CAT(a, b)	a ## b
+
+	static const char *warm_str = STR(warm	header) "\t\"str\"";
+static const int warm_chr = 'w' + L'\x41' + 0x1fULL + 1.5e3f;
+#warning "from the cached header"
+static int CAT(warm_, var) = sizeof(warm_str);
@@ -0,0 +1,26 @@
+static int lt(int a, int b)
+{
+	return a < b;
+}
+
+static int self_lt(int a)
+{
+	return a < a;
+}
+
+int foo(int x)
+{
+	return lt(x, x) + self_lt(x);
+}
+
+/*
+ * check-name: warning-inline
+ * check-description: the warnings given by the optimizations must
+ *	not depend on the inlining: the inlined copies of a function
+ *	were already checked with it.
+ * check-command: sparse -Wno-decl -Wtautological-compare $file
+ *
+ * check-error-start
+warning-inline.c:8:20: warning: self-comparison always evaluates to false
+ * check-error-end
+ */